@@ -110,6 +110,22 @@ static inline void computeSlopeMap(int width, int height, const std::function<fl
 	}
 }
 
+// slope from a precomputed gradient field (e.g. the analytic one from world generation), same scale as computeSlopeMap
+static inline void computeSlopeMapFromGradient(const GridFloat& gradX, const GridFloat& gradY, std::vector<float>& outSlope, float expectedMaxGrad = 0.18f) {
+	const int width = gradX.width();
+	const int height = gradX.height();
+	outSlope.assign(width * height, 0.0f);
+#pragma omp parallel for collapse(2) schedule(static)
+	for (int y = 0; y < height; y++) {
+		for (int x = 0; x < width; x++) {
+			float dx = gradX(x, y);
+			float dy = gradY(x, y);
+			float grad = std::sqrt(dx * dx + dy * dy);
+			outSlope[y * width + x] = std::clamp(grad / std::max(1e-6f, expectedMaxGrad), 0.0f, 1.0f);
+		}
+	}
+}
+
 template <typename T>
 static inline void majorityFilter(int W, int H, std::vector<T>& mapData, int iterations = 1) {
 	if (iterations <= 0) return;
@@ -224,13 +240,16 @@ static inline Biome chooseBestBiome(const std::vector<BiomeDef>& defs, float ele
 }
 
 static inline bool classifyBiomeMap(const GridFloat& heightGrid, const GridFloat& tempGrid, const GridFloat& moistGrid, const GridInt* riverMaskGrid,
-									const std::vector<BiomeDef>& defs, GridBiome& outBiomeGrid, const ClassifierOptions& opts = ClassifierOptions()) {
+									const std::vector<BiomeDef>& defs, GridBiome& outBiomeGrid, const ClassifierOptions& opts = ClassifierOptions(),
+									const GridFloat* gradX = nullptr, const GridFloat* gradY = nullptr) {
 	const int W = heightGrid.width();
 	const int H = heightGrid.height();
 	if (tempGrid.width() != W || tempGrid.height() != H) return false;
 	if (moistGrid.width() != W || moistGrid.height() != H) return false;
 	if (outBiomeGrid.width() != W || outBiomeGrid.height() != H) return false;
 	if (riverMaskGrid && (riverMaskGrid->width() != W || riverMaskGrid->height() != H)) return false;
+	const bool haveGrad = gradX && gradY;
+	if (haveGrad && (gradX->width() != W || gradX->height() != H || gradY->width() != W || gradY->height() != H)) return false;
 
 	std::vector<int> oceanMask(W * H, 0);
 	std::vector<int> lakeMask(W * H, 0);
@@ -258,7 +277,10 @@ static inline bool classifyBiomeMap(const GridFloat& heightGrid, const GridFloat
 	if (!riverMask.empty()) computeNearMaskFromSources(W, H, riverMask, opts.riverDistanceTiles, nearRiver);
 
 	std::vector<float> slopeMap;
-	computeSlopeMap(W, H, [&](int x, int y) -> float { return heightGrid(x, y); }, slopeMap, opts.expectedMaxGradient);
+	if (haveGrad)
+		computeSlopeMapFromGradient(*gradX, *gradY, slopeMap, opts.expectedMaxGradient);
+	else
+		computeSlopeMap(W, H, [&](int x, int y) -> float { return heightGrid(x, y); }, slopeMap, opts.expectedMaxGradient);
 
 	std::vector<Biome> chosen(W * H, Biome::Unknown);
 #pragma omp parallel for collapse(2)
@@ -91,6 +91,33 @@ static Grid2D<T> makeGridFromFn(int width, int height, Fn&& f) {
 	return g;
 }
 
+// axis aligned pixel rectangle [x, x + w) x [y, y + h)
+struct Rect {
+	int x = 0, y = 0, w = 0, h = 0;
+
+	Rect() = default;
+	Rect(int x_, int y_, int w_, int h_) : x(x_), y(y_), w(w_), h(h_) {}
+	static Rect ofGrid(int width, int height) { return Rect(0, 0, width, height); }
+
+	bool empty() const { return w <= 0 || h <= 0; }
+	int x1() const { return x + w; }
+	int y1() const { return y + h; }
+	bool contains(int px, int py) const { return px >= x && px < x1() && py >= y && py < y1(); }
+
+	Rect intersect(const Rect& o) const {
+		int nx = std::max(x, o.x), ny = std::max(y, o.y);
+		return Rect(nx, ny, std::max(0, std::min(x1(), o.x1()) - nx), std::max(0, std::min(y1(), o.y1()) - ny));
+	}
+	// bounding box of both, an empty rect doesn't count
+	Rect unite(const Rect& o) const {
+		if (empty()) return o;
+		if (o.empty()) return *this;
+		int nx = std::min(x, o.x), ny = std::min(y, o.y);
+		return Rect(nx, ny, std::max(x1(), o.x1()) - nx, std::max(y1(), o.y1()) - ny);
+	}
+	Rect inflate(int by) const { return empty() ? *this : Rect(x - by, y - by, w + 2 * by, h + 2 * by); }
+};
+
 using GridFloat = Grid2D<float>;
 using GridU8 = Grid2D<uint8_t>;
 using GridInt = Grid2D<int>;
@@ -1,8 +1,23 @@
 #pragma once
 
+#include <vector>
+
 using ll = long long;
 
+enum class ErosionModel {
+	Droplets,  // particle droplets (runHydraulicErosion)
+	Pipe,	   // grid shallow-water / virtual pipe model (runPipeErosion)
+};
+
+// order droplets are handed to the threads in
+enum class DropletOrder {
+	Index,	 // droplet index, spawn points scattered over the whole map
+	Morton,	 // sorted by spawn cell along a z-order curve
+	Hilbert,  // sorted along a hilbert curve, slightly better locality than morton
+};
+
 struct ErosionParams {
+	ErosionModel model = ErosionModel::Droplets;
 	ll worldSeed = 424242;
 	int numDroplets = 200000;  // keep this under 1e7 so lap doesnt go boom
 	int maxSteps = 45;
@@ -20,7 +35,61 @@ struct ErosionParams {
 	float erodeRate = 0.5f;
 	float depositRate = 0.3f;
 	float maxErodePerStep = 0.1f;
-	int erosionRadius = 3;
+	int erosionRadius = 0;	// erosion spread over the cells within this radius, <= 0 = the 4 bilinear corners
 
+	// true: every thread accumulates into its own full-grid buffers (memory = threads x map), the sums can
+	// differ in the last bits with the thread count.
+	// false: tile engine, droplets bucketed by spawn tile, non-adjacent tiles splat into the map buffers
+	// (memory ~ map), same result for any thread count
 	bool usePerThreadBuffers = true;
+	int tileSize = 128;	 // tile engine only, raised to two droplet reaches if smaller
+
+	// spatial order keeps consecutive droplets of a thread in one patch of the map (cache locality);
+	// rng streams stay keyed by droplet index, only the accumulation order changes
+	DropletOrder dropletOrder = DropletOrder::Index;
+
+	// droplets sample height + gradient from a packed (h, dh/dx, dh/dy) field built once per epoch: one
+	// 4-corner fetch per step instead of five bilinear samples. same values as the default sampling up
+	// to rounding, but rounding differences let droplet paths drift apart, so totals differ slightly
+	bool packedGradient = false;
+
+	// 0 = one droplet at a time, 8 or 16 = that many droplets simulated in lockstep simd lanes
+	// (same per-droplet math, splat order differs so sums match the scalar path up to rounding)
+	int dropletLanes = 0;
+
+	// droplets run in this many batches (by droplet index), the reduced deltas are applied to the height
+	// between batches so later droplets flow over the already eroded terrain. 1 = single pass over the
+	// input height
+	int epochs = 1;
+
+	// run modes, both off by default (every droplet runs). ErosionStats reports how many droplets ran.
+	// the time budget is checked per chunk of droplets (1/16 of an epoch, buffers are set up and reduced once
+	// per epoch around the chunks), the convergence test between epochs, so that one needs epochs > 1.
+	// the pipe model splits pipeIterations into the epochs the same way and checks the budget before every iteration
+	double timeBudgetMs = 0.0;	   // > 0: stop starting droplets once the next chunk would end past this
+	float convergeEpsilon = 0.0f;  // > 0: stop after an epoch whose mean |height change| per cell is below this
+
+	// pyramid mode (droplets only): erode successively halved copies of the height first, coarsest
+	// first, each level starting from the one below plus the upsampled change of the level above it,
+	// then finish with a full-resolution pass for the fine detail. long channels form where they are
+	// cheap. 0 = off
+	int pyramidLevels = 0;
+	// droplets per level as a share of numDroplets, index 0 = the full-resolution pass, 1 = half size ...
+	// levels without an entry: the coarsest gets 1 / 4^level (same droplets per cell as the full map,
+	// about one full run of erosion), the finer ones a quarter of that density (0.25 / 4^level)
+	std::vector<float> pyramidDroplets;
+
+	// pipe model only, rates are per unit of simulated time. gravity and maxErodePerStep are shared
+	// with the droplets
+	int pipeIterations = 150;
+	float pipeTimeStep = 0.05f;
+	float pipeLength = 1.0f;	   // cell spacing in world units
+	float pipeRain = 0.02f;		   // water per cell per unit time
+	float pipeEvaporation = 0.5f;  // share of the water evaporating per unit time
+	float pipeFriction = 2.0f;	   // share of the pipe flux lost per unit time, damps sloshing
+	float pipeCapacity = 2.0f;	   // sediment capacity per unit of tilt * speed
+	float pipeDissolve = 0.5f;
+	float pipeDeposit = 1.0f;
+	float pipeMinTilt = 0.01f;	   // floor on the slope term, keeps flats carrying some sediment
+	float pipeDepthScale = 0.05f;  // water depth at which a cell reaches its full carrying capacity
 };
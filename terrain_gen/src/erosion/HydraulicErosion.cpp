@@ -4,11 +4,25 @@
 
 #include <algorithm>
 #include <cassert>
+#include <chrono>
 #include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
 #include <cstring>
 #include <limits>
 #include <vector>
 
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define EROSION_SIMD_X86 1
+#include <immintrin.h>
+#else
+#define EROSION_SIMD_X86 0
+#endif
+
+#include "Log.h"
+#include "PipeErosion.h"
+#include "PyramidErosion.h"
 #include "util.h"
 
 using namespace std;
@@ -43,7 +57,53 @@ static inline void sampleHeightAndGradient(const GridFloat &g, float fx, float f
 	gy = (hy - ly) * 0.5f / eps;  // dH/dy
 }
 
-static inline void accumulateToCellQuad(vector<double> &buf, int w, int h, float fx, float fy, double amount) {
+// one cell of the packed sampling field (params.packedGradient): height and its central-difference
+// gradient side by side, so height + gradient at a point is one bilinear fetch of 4 of these
+struct alignas(16) HeightSample {
+	float h, gx, gy, pad;
+};
+
+static void buildHeightSamples(const GridFloat &g, vector<HeightSample> &out) {
+	const int w = g.width(), h = g.height();
+	out.resize((size_t)w * h);
+#pragma omp parallel for schedule(static)
+	for (int y = 0; y < h; y++) {
+		const float *r = g.data() + (size_t)y * w;
+		const float *up = g.data() + (size_t)std::max(y - 1, 0) * w;
+		const float *dn = g.data() + (size_t)std::min(y + 1, h - 1) * w;
+		HeightSample *o = out.data() + (size_t)y * w;
+		for (int x = 0; x < w; x++) {
+			o[x].h = r[x];
+			o[x].gx = (r[std::min(x + 1, w - 1)] - r[std::max(x - 1, 0)]) * 0.5f;
+			o[x].gy = (dn[x] - up[x]) * 0.5f;
+			o[x].pad = 0.0f;
+		}
+	}
+}
+
+// bilinear height and gradient from the packed field, same clamping as sampleBilinear. this is
+// sampleHeightAndGradient up to rounding: the shifted bilinear samples share their weights, so their
+// difference is one bilinear sample of the per-cell differences (edge-clamped the same way)
+static inline void samplePacked(const HeightSample *f, int w, int h, float fx, float fy, float &heightOut, float &gx, float &gy) {
+	if (fx < 0) fx = 0;
+	if (fy < 0) fy = 0;
+	if (fx > w - 1) fx = (float)(w - 1);
+	if (fy > h - 1) fy = (float)(h - 1);
+	int x0 = (int)fx;
+	int y0 = (int)fy;
+	int x1 = std::min(x0 + 1, w - 1);
+	int y1 = std::min(y0 + 1, h - 1);
+	float sx = fx - x0, sy = fy - y0;
+	const HeightSample &a = f[(size_t)y0 * w + x0], &b = f[(size_t)y0 * w + x1], &c = f[(size_t)y1 * w + x0], &d = f[(size_t)y1 * w + x1];
+	float w00 = (1 - sx) * (1 - sy), w10 = sx * (1 - sy), w01 = (1 - sx) * sy, w11 = sx * sy;
+	heightOut = a.h * w00 + b.h * w10 + c.h * w01 + d.h * w11;
+	gx = a.gx * w00 + b.gx * w10 + c.gx * w01 + d.gx * w11;
+	gy = a.gy * w00 + b.gy * w10 + c.gy * w01 + d.gy * w11;
+}
+
+// bilinear splat of `amount` at (fx, fy) in map coords (W x H) into a buffer covering the map window
+// starting at (ox, oy), `stride` cells per row. the legacy full-grid buffers are ox = oy = 0, stride = W
+static inline void accumulateToCellQuad(double *buf, int ox, int oy, size_t stride, int w, int h, float fx, float fy, double amount) {
 	if (amount == 0.0) return;
 	if (w <= 0 || h <= 0) return;
 
@@ -72,133 +132,1107 @@ static inline void accumulateToCellQuad(vector<double> &buf, int w, int h, float
 	double w01 = (1.0 - sx) * sy;
 	double w11 = sx * sy;
 
-	auto idx = [&](int x, int y) -> size_t { return (size_t)y * (size_t)w + (size_t)x; };
+	auto idx = [&](int x, int y) -> size_t { return (size_t)(y - oy) * stride + (size_t)(x - ox); };
 
-	size_t nCells = (size_t)w * (size_t)h;
-	if (idx(x0, y0) < nCells) buf[idx(x0, y0)] += amount * w00;
-	if (idx(x1, y0) < nCells) buf[idx(x1, y0)] += amount * w10;
-	if (idx(x0, y1) < nCells) buf[idx(x0, y1)] += amount * w01;
-	if (idx(x1, y1) < nCells) buf[idx(x1, y1)] += amount * w11;
+	buf[idx(x0, y0)] += amount * w00;
+	buf[idx(x1, y0)] += amount * w10;
+	buf[idx(x0, y1)] += amount * w01;
+	buf[idx(x1, y1)] += amount * w11;
+}
+
+// erosion brush for erosionRadius > 0: every cell closer than the radius to the droplet's cell, weighted
+// by 1 - dist / radius and normalised. built once per run, `offsets` are dy * stride + dx for the stride
+// of the buffer it splats into, so the inner loop is a plain scatter over a fixed stencil
+struct ErosionBrush {
+	int reach = 0;	// largest |dx|, |dy| of the stencil
+	std::vector<int> dx, dy;
+	std::vector<float> weight;
+	std::vector<ptrdiff_t> offsets;
+	size_t stride = 0;
+
+	static ErosionBrush make(int radius) {
+		ErosionBrush b;
+		if (radius <= 0) return b;
+		float sum = 0.0f;
+		for (int y = -radius; y <= radius; y++)
+			for (int x = -radius; x <= radius; x++) {
+				float d = std::sqrt((float)(x * x + y * y));
+				if (d >= (float)radius) continue;
+				b.dx.push_back(x);
+				b.dy.push_back(y);
+				b.weight.push_back(1.0f - d / (float)radius);
+				sum += b.weight.back();
+				b.reach = std::max(b.reach, std::max(std::abs(x), std::abs(y)));
+			}
+		for (float &w : b.weight) w /= sum;
+		return b;
+	}
+	bool enabled() const { return !weight.empty(); }
+	void setStride(size_t s) {
+		if (s == stride && offsets.size() == weight.size()) return;
+		stride = s;
+		offsets.resize(weight.size());
+		for (size_t k = 0; k < weight.size(); k++) offsets[k] = (ptrdiff_t)dy[k] * (ptrdiff_t)s + dx[k];
+	}
+};
+
+// where the erode / deposit of one droplet batch goes: a window of the map, see accumulateToCellQuad.
+// erosion goes through `brush` when set (offsets matching `stride`), otherwise to the bilinear quad
+struct SplatTarget {
+	double *erode;
+	double *deposit;
+	int ox, oy;
+	size_t stride;
+	const ErosionBrush *brush = nullptr;
+};
+
+static inline void splatErosion(const SplatTarget &out, int w, int h, float fx, float fy, double amount) {
+	if (!out.brush) {
+		accumulateToCellQuad(out.erode, out.ox, out.oy, out.stride, w, h, fx, fy, amount);
+		return;
+	}
+	if (amount == 0.0) return;
+	const ErosionBrush &b = *out.brush;
+	int cx = std::clamp((int)fx, 0, w - 1);
+	int cy = std::clamp((int)fy, 0, h - 1);
+	const size_t n = b.weight.size();
+	if (cx >= b.reach && cy >= b.reach && cx + b.reach < w && cy + b.reach < h) {
+		double *c = out.erode + (size_t)(cy - out.oy) * out.stride + (size_t)(cx - out.ox);
+		// the stencil offsets are distinct, so the scatter has no conflicts
+#pragma omp simd
+		for (size_t k = 0; k < n; k++) c[b.offsets[k]] += amount * b.weight[k];
+		return;
+	}
+	// near the map border: only the cells on the map, renormalised
+	float sum = 0.0f;
+	for (size_t k = 0; k < n; k++) {
+		int x = cx + b.dx[k], y = cy + b.dy[k];
+		if (x >= 0 && y >= 0 && x < w && y < h) sum += b.weight[k];
+	}
+	double scale = amount / sum;
+	for (size_t k = 0; k < n; k++) {
+		int x = cx + b.dx[k], y = cy + b.dy[k];
+		if (x >= 0 && y >= 0 && x < w && y < h) out.erode[(size_t)(y - out.oy) * out.stride + (size_t)(x - out.ox)] += scale * b.weight[k];
+	}
 }
 
 static inline float clampf(float v, float lo, float hi) { return v < lo ? lo : (v > hi ? hi : v); }
 
-ErosionStats runHydraulicErosion(GridFloat &heightGrid, const ErosionParams &params, GridFloat *outEroded, GridFloat *outDeposited) {
+// droplet di's rng, positioned after drawing its spawn point
+static inline rng_util::RNG spawnDroplet(const ErosionParams &params, int di, int W, int H, float &x, float &y) {
+	ll seedState = params.worldSeed;
+	ll localState = seedState ^ (ll)di * 2654435761LL;
+	ll seed = rng_util::splitmix(localState);
+	rng_util::RNG rng(seed);
+	x = rng.nextFloat() * (float)(W - 1);
+	y = rng.nextFloat() * (float)(H - 1);
+	return rng;
+}
+
+// one droplet from spawn to termination over `g`, adding its erosion / deposition into `out`
+static void simulateDroplet(const GridFloat &heightGrid, const HeightSample *packed, const ErosionParams &params, int di, const SplatTarget &out) {
 	int W = heightGrid.width();
 	int H = heightGrid.height();
-	const int N = params.numDroplets;
 	const int maxSteps = params.maxSteps;
 
-	const int numThreads = omp_get_max_threads();
+	// initialize droplet
+	float x, y;
+	rng_util::RNG rng = spawnDroplet(params, di, W, H, x, y);
+	float dirX = 0.0f, dirY = 0.0f;
+	float speed = params.initSpeed;
+	float water = params.initWater;
+	float sediment = 0.0f;
 
-	vector<vector<double>> erodeBufs, depositBufs;
-	erodeBufs.resize(numThreads);
-	depositBufs.resize(numThreads);
-	const size_t nCells = (size_t)W * (size_t)H;
+	for (int i = 0; i < maxSteps; i++) {
+		float heightHere, gradX, gradY;
+		if (packed)
+			samplePacked(packed, W, H, x, y, heightHere, gradX, gradY);
+		else
+			sampleHeightAndGradient(heightGrid, x, y, heightHere, gradX, gradY);
 
-	for (int t = 0; t < numThreads; t++) {
-		erodeBufs[t].assign(nCells, 0.0);
-		depositBufs[t].assign(nCells, 0.0);
+		// update direction: inertia + slope influence
+		dirX = dirX * params.inertia - gradX * (1.0f - params.inertia);
+		dirY = dirY * params.inertia - gradY * (1.0f - params.inertia);
+		float len = sqrtf(dirX * dirX + dirY * dirY);
+		if (len == 0.0f) {
+			double r = rng.nextFloat();
+			double theta = r * 2.0 * 3.141592653589793;
+			dirX = (float)cos(theta) * 1e-6f;
+			dirY = (float)sin(theta) * 1e-6f;
+			len = sqrtf(dirX * dirX + dirY * dirY);
+		}
+		dirX /= len;
+		dirY /= len;
+
+		// move
+		x += dirX * params.stepSize;
+		y += dirY * params.stepSize;
+
+		if (x < 0.0f || x > (W - 1) || y < 0.0f || y > (H - 1)) break;
+
+		float newHeight = sampleBilinear(heightGrid, x, y);
+		float deltaH = newHeight - heightHere;
+
+		float potential = -deltaH;	// downhill positive
+		speed = sqrtf(std::max(0.0f, speed * speed + potential * params.gravity));
+
+		float slope = std::max(1e-6f, -deltaH / params.stepSize);
+
+		float capacity = std::max(0.0f, params.capacityFactor * speed * water * slope);
+
+		if (sediment > capacity) {
+			double deposit = params.depositRate * (sediment - capacity);
+			deposit = std::min<double>(deposit, sediment);
+			accumulateToCellQuad(out.deposit, out.ox, out.oy, out.stride, W, H, x, y, deposit);
+			sediment -= (float)deposit;
+		} else {
+			double delta = params.capacityFactor * (capacity - sediment);
+			double erode = params.erodeRate * delta;
+			erode = std::min(erode, (double)params.maxErodePerStep);
+			double localHeight = newHeight;
+			erode = std::min(erode, std::max(0.0, localHeight));
+			if (erode > 0.0) {
+				splatErosion(out, W, H, x, y, erode);
+				sediment += (float)erode;
+			}
+		}
+
+		water *= (1.0f - params.evaporateRate);
+		if (water < params.minWater) break;
+		if (speed < params.minSpeed) break;
+	}
+}
+
+// ---- lockstep droplets ----
+// L droplets advance one step at a time in structure-of-arrays lanes; a lane whose droplet terminates
+// is refilled with the next one from the list, so the lanes stay busy until the list runs dry. the
+// per-lane math is the scalar step in the same operation order; `Lanes` supplies the lane loops, as
+// omp simd loops (GenericLanes) or as avx2 / avx-512 intrinsics with gathers for the bilinear fetches.
+// splats are applied after each step in lane order, so lanes never race on a cell.
+
+struct GenericLanes {
+	template <int L>
+	static void bilinear(const GridFloat &g, const float *fx, const float *fy, float *out) {
+		const float *d = g.data();
+		const int w = g.width(), h = g.height();
+#pragma omp simd
+		for (int l = 0; l < L; l++) {
+			float px = fx[l] < 0 ? 0.0f : fx[l];
+			float py = fy[l] < 0 ? 0.0f : fy[l];
+			px = px > w - 1 ? (float)(w - 1) : px;
+			py = py > h - 1 ? (float)(h - 1) : py;
+			int x0 = (int)px;  // px, py >= 0: truncation is floor
+			int y0 = (int)py;
+			int x1 = std::min(x0 + 1, w - 1);
+			int y1 = std::min(y0 + 1, h - 1);
+			float sx = px - x0, sy = py - y0;
+			float v00 = d[(size_t)y0 * w + x0], v10 = d[(size_t)y0 * w + x1], v01 = d[(size_t)y1 * w + x0], v11 = d[(size_t)y1 * w + x1];
+			float a = v00 * (1 - sx) + v10 * sx;
+			float b = v01 * (1 - sx) + v11 * sx;
+			out[l] = a * (1 - sy) + b * sy;
+		}
 	}
-	std::cerr << "[ERODE DEBUG] entering droplet loop (parallel) ..." << std::endl;
 
+	template <int L>
+	static void packed(const HeightSample *f, int w, int h, const float *fx, const float *fy, float *heightOut, float *gx, float *gy) {
+#pragma omp simd
+		for (int l = 0; l < L; l++) samplePacked(f, w, h, fx[l], fy[l], heightOut[l], gx[l], gy[l]);
+	}
+
+	// inertia + slope influence
+	template <int L>
+	static void direction(const ErosionParams &params, const float *gradX, const float *gradY, float *dirX, float *dirY, float *len) {
+#pragma omp simd
+		for (int l = 0; l < L; l++) {
+			dirX[l] = dirX[l] * params.inertia - gradX[l] * (1.0f - params.inertia);
+			dirY[l] = dirY[l] * params.inertia - gradY[l] * (1.0f - params.inertia);
+			len[l] = sqrtf(dirX[l] * dirX[l] + dirY[l] * dirY[l]);
+		}
+	}
+
+	// normalise and step, lanes that leave the map stop. empty lanes carry len 0 from the zero sample,
+	// keep them finite
+	template <int L>
+	static void move(const ErosionParams &params, int W, int H, const float *len, float *dirX, float *dirY, float *x, float *y, int *live) {
+#pragma omp simd
+		for (int l = 0; l < L; l++) {
+			float inv = live[l] ? len[l] : 1.0f;
+			dirX[l] /= inv;
+			dirY[l] /= inv;
+			x[l] += dirX[l] * params.stepSize;
+			y[l] += dirY[l] * params.stepSize;
+			bool outside = x[l] < 0.0f || x[l] > (W - 1) || y[l] < 0.0f || y[l] > (H - 1);
+			live[l] = live[l] && !outside;
+		}
+	}
+
+	// speed, capacity and the deposit / erode of the step: splat 0 nothing, 1 deposit, 2 erode
+	template <int L>
+	static void transport(const ErosionParams &params, const int *live, const float *newHeight, const float *heightHere, float *speed, float *water,
+						  float *sediment, int *splat, double *amount) {
+#pragma omp simd
+		for (int l = 0; l < L; l++) {
+			float deltaH = newHeight[l] - heightHere[l];
+			float potential = -deltaH;	// downhill positive
+			speed[l] = sqrtf(std::max(0.0f, speed[l] * speed[l] + potential * params.gravity));
+			float slope = std::max(1e-6f, -deltaH / params.stepSize);
+			float capacity = std::max(0.0f, params.capacityFactor * speed[l] * water[l] * slope);
+
+			double deposit = params.depositRate * (sediment[l] - capacity);
+			deposit = std::min<double>(deposit, sediment[l]);
+			double delta = params.capacityFactor * (capacity - sediment[l]);
+			double erode = params.erodeRate * delta;
+			erode = std::min(erode, (double)params.maxErodePerStep);
+			double localHeight = newHeight[l];
+			erode = std::min(erode, std::max(0.0, localHeight));
+
+			bool depositing = sediment[l] > capacity;
+			bool eroding = !depositing && erode > 0.0;
+			splat[l] = live[l] ? (depositing ? 1 : (eroding ? 2 : 0)) : 0;
+			amount[l] = depositing ? deposit : erode;
+			float change = depositing ? -(float)deposit : (eroding ? (float)erode : 0.0f);
+			sediment[l] = live[l] ? sediment[l] + change : sediment[l];
+			water[l] *= (1.0f - params.evaporateRate);
+		}
+	}
+};
+
+#if EROSION_SIMD_X86
+
+// the portable build only has sse2: no gathers, and the sqrtf / mixed float-double lane loops do not
+// vectorise, so these write the GenericLanes loops out in intrinsics. same expressions term by term
+// (no fma, compare + blend for the clamps, std::min / std::max argument order kept) to stay bit-exact.
+// the gathers take 32-bit cell indices, the kernels are only picked for maps below 2^29 cells
+
+#define EROSION_AVX2 __attribute__((target("avx2")))
+#define EROSION_AVX512 __attribute__((target("avx512f")))
+
+// ---------------- AVX2 (8 lanes) ----------------
+struct Avx2Lanes {
+	// clamp to [0, hi] as in sampleBilinear: fx < 0 -> 0, then fx > hi -> hi
+	EROSION_AVX2 static inline __m256 clampCoord(__m256 v, __m256 hi) {
+		const __m256 zero = _mm256_setzero_ps();
+		v = _mm256_blendv_ps(v, zero, _mm256_cmp_ps(v, zero, _CMP_LT_OQ));
+		return _mm256_blendv_ps(v, hi, _mm256_cmp_ps(v, hi, _CMP_GT_OQ));
+	}
+
+	// cell index of (x0, y0), the +1 neighbour steps and the fractions of 8 clamped points
+	EROSION_AVX2 static inline void cellOf(int w, int h, __m256 fx, __m256 fy, __m256i &i00, __m256i &stepX, __m256i &stepY, __m256 &sx, __m256 &sy) {
+		__m256 px = clampCoord(fx, _mm256_set1_ps((float)(w - 1)));
+		__m256 py = clampCoord(fy, _mm256_set1_ps((float)(h - 1)));
+		__m256i x0 = _mm256_cvttps_epi32(px), y0 = _mm256_cvttps_epi32(py);
+		__m256i one = _mm256_set1_epi32(1);
+		__m256i x1 = _mm256_min_epi32(_mm256_add_epi32(x0, one), _mm256_set1_epi32(w - 1));
+		__m256i y1 = _mm256_min_epi32(_mm256_add_epi32(y0, one), _mm256_set1_epi32(h - 1));
+		sx = _mm256_sub_ps(px, _mm256_cvtepi32_ps(x0));
+		sy = _mm256_sub_ps(py, _mm256_cvtepi32_ps(y0));
+		__m256i vw = _mm256_set1_epi32(w);
+		i00 = _mm256_add_epi32(_mm256_mullo_epi32(y0, vw), x0);
+		stepX = _mm256_sub_epi32(x1, x0);
+		stepY = _mm256_mullo_epi32(_mm256_sub_epi32(y1, y0), vw);
+	}
+
+	// a * wa + b * wb, the bilinear lerp
+	EROSION_AVX2 static inline __m256 lerp(__m256 a, __m256 b, __m256 s) {
+		return _mm256_add_ps(_mm256_mul_ps(a, _mm256_sub_ps(_mm256_set1_ps(1.0f), s)), _mm256_mul_ps(b, s));
+	}
+
+	template <int L>
+	EROSION_AVX2 static void bilinear(const GridFloat &g, const float *fx, const float *fy, float *out) {
+		const float *d = g.data();
+		for (int l = 0; l < L; l += 8) {
+			__m256i i00, stepX, stepY;
+			__m256 sx, sy;
+			cellOf(g.width(), g.height(), _mm256_loadu_ps(fx + l), _mm256_loadu_ps(fy + l), i00, stepX, stepY, sx, sy);
+			__m256i i01 = _mm256_add_epi32(i00, stepY);
+			__m256 v00 = _mm256_i32gather_ps(d, i00, 4), v10 = _mm256_i32gather_ps(d, _mm256_add_epi32(i00, stepX), 4);
+			__m256 v01 = _mm256_i32gather_ps(d, i01, 4), v11 = _mm256_i32gather_ps(d, _mm256_add_epi32(i01, stepX), 4);
+			_mm256_storeu_ps(out + l, lerp(lerp(v00, v10, sx), lerp(v01, v11, sx), sy));
+		}
+	}
+
+	template <int L>
+	EROSION_AVX2 static void packed(const HeightSample *f, int w, int h, const float *fx, const float *fy, float *heightOut, float *gx, float *gy) {
+		const float *base = &f->h;	// 4 floats per cell
+		for (int l = 0; l < L; l += 8) {
+			__m256i i00, stepX, stepY;
+			__m256 sx, sy;
+			cellOf(w, h, _mm256_loadu_ps(fx + l), _mm256_loadu_ps(fy + l), i00, stepX, stepY, sx, sy);
+			__m256i c[4];
+			c[0] = _mm256_slli_epi32(i00, 2);
+			c[1] = _mm256_slli_epi32(_mm256_add_epi32(i00, stepX), 2);
+			c[2] = _mm256_slli_epi32(_mm256_add_epi32(i00, stepY), 2);
+			c[3] = _mm256_slli_epi32(_mm256_add_epi32(_mm256_add_epi32(i00, stepY), stepX), 2);
+			const __m256 one = _mm256_set1_ps(1.0f);
+			__m256 ox = _mm256_sub_ps(one, sx), oy = _mm256_sub_ps(one, sy);
+			__m256 wq[4] = {_mm256_mul_ps(ox, oy), _mm256_mul_ps(sx, oy), _mm256_mul_ps(ox, sy), _mm256_mul_ps(sx, sy)};
+			float *dst[3] = {heightOut + l, gx + l, gy + l};
+			for (int k = 0; k < 3; k++) {
+				__m256 acc = _mm256_mul_ps(_mm256_i32gather_ps(base + k, c[0], 4), wq[0]);
+				for (int q = 1; q < 4; q++) acc = _mm256_add_ps(acc, _mm256_mul_ps(_mm256_i32gather_ps(base + k, c[q], 4), wq[q]));
+				_mm256_storeu_ps(dst[k], acc);
+			}
+		}
+	}
+
+	template <int L>
+	EROSION_AVX2 static void direction(const ErosionParams &params, const float *gradX, const float *gradY, float *dirX, float *dirY, float *len) {
+		const __m256 inertia = _mm256_set1_ps(params.inertia), pull = _mm256_set1_ps(1.0f - params.inertia);
+		for (int l = 0; l < L; l += 8) {
+			__m256 dx = _mm256_sub_ps(_mm256_mul_ps(_mm256_loadu_ps(dirX + l), inertia), _mm256_mul_ps(_mm256_loadu_ps(gradX + l), pull));
+			__m256 dy = _mm256_sub_ps(_mm256_mul_ps(_mm256_loadu_ps(dirY + l), inertia), _mm256_mul_ps(_mm256_loadu_ps(gradY + l), pull));
+			_mm256_storeu_ps(dirX + l, dx);
+			_mm256_storeu_ps(dirY + l, dy);
+			_mm256_storeu_ps(len + l, _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy))));
+		}
+	}
+
+	template <int L>
+	EROSION_AVX2 static void move(const ErosionParams &params, int W, int H, const float *len, float *dirX, float *dirY, float *x, float *y, int *live) {
+		const __m256 step = _mm256_set1_ps(params.stepSize), zero = _mm256_setzero_ps();
+		const __m256 maxX = _mm256_set1_ps((float)(W - 1)), maxY = _mm256_set1_ps((float)(H - 1));
+		for (int l = 0; l < L; l += 8) {
+			__m256i lv = _mm256_loadu_si256((const __m256i *)(live + l));
+			__m256 idle = _mm256_castsi256_ps(_mm256_cmpeq_epi32(lv, _mm256_setzero_si256()));
+			__m256 inv = _mm256_blendv_ps(_mm256_loadu_ps(len + l), _mm256_set1_ps(1.0f), idle);
+			__m256 dx = _mm256_div_ps(_mm256_loadu_ps(dirX + l), inv), dy = _mm256_div_ps(_mm256_loadu_ps(dirY + l), inv);
+			__m256 px = _mm256_add_ps(_mm256_loadu_ps(x + l), _mm256_mul_ps(dx, step));
+			__m256 py = _mm256_add_ps(_mm256_loadu_ps(y + l), _mm256_mul_ps(dy, step));
+			__m256 outside = _mm256_or_ps(_mm256_or_ps(_mm256_cmp_ps(px, zero, _CMP_LT_OQ), _mm256_cmp_ps(px, maxX, _CMP_GT_OQ)),
+										  _mm256_or_ps(_mm256_cmp_ps(py, zero, _CMP_LT_OQ), _mm256_cmp_ps(py, maxY, _CMP_GT_OQ)));
+			_mm256_storeu_ps(dirX + l, dx);
+			_mm256_storeu_ps(dirY + l, dy);
+			_mm256_storeu_ps(x + l, px);
+			_mm256_storeu_ps(y + l, py);
+			_mm256_storeu_si256((__m256i *)(live + l), _mm256_andnot_si256(_mm256_castps_si256(outside), lv));
+		}
+	}
+
+	// 8 floats <-> 2 x 4 doubles, and the matching masks
+	EROSION_AVX2 static inline __m256d widenLo(__m256 v) { return _mm256_cvtps_pd(_mm256_castps256_ps128(v)); }
+	EROSION_AVX2 static inline __m256d widenHi(__m256 v) { return _mm256_cvtps_pd(_mm256_extractf128_ps(v, 1)); }
+	EROSION_AVX2 static inline __m256 narrow(__m256d lo, __m256d hi) { return _mm256_set_m128(_mm256_cvtpd_ps(hi), _mm256_cvtpd_ps(lo)); }
+	EROSION_AVX2 static inline __m256d maskLo(__m256 m) { return _mm256_castsi256_pd(_mm256_cvtepi32_epi64(_mm256_castsi256_si128(_mm256_castps_si256(m)))); }
+	EROSION_AVX2 static inline __m256d maskHi(__m256 m) { return _mm256_castsi256_pd(_mm256_cvtepi32_epi64(_mm256_extracti128_si256(_mm256_castps_si256(m), 1))); }
+	EROSION_AVX2 static inline __m256 maskNarrow(__m256d lo, __m256d hi) {
+		const __m256i even = _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6);
+		return _mm256_set_m128(_mm256_castps256_ps128(_mm256_permutevar8x32_ps(_mm256_castpd_ps(hi), even)),
+							   _mm256_castps256_ps128(_mm256_permutevar8x32_ps(_mm256_castpd_ps(lo), even)));
+	}
+
+	template <int L>
+	EROSION_AVX2 static void transport(const ErosionParams &params, const int *live, const float *newHeight, const float *heightHere, float *speed,
+									   float *water, float *sediment, int *splat, double *amount) {
+		const __m256 zero = _mm256_setzero_ps(), signBit = _mm256_set1_ps(-0.0f);
+		const __m256 gravity = _mm256_set1_ps(params.gravity), stepSize = _mm256_set1_ps(params.stepSize), minSlope = _mm256_set1_ps(1e-6f);
+		const __m256 capacityFactor = _mm256_set1_ps(params.capacityFactor), depositRate = _mm256_set1_ps(params.depositRate);
+		const __m256 keep = _mm256_set1_ps(1.0f - params.evaporateRate);
+		const __m256d erodeRate = _mm256_set1_pd((double)params.erodeRate), maxErode = _mm256_set1_pd((double)params.maxErodePerStep);
+		const __m256d zeroD = _mm256_setzero_pd();
+		for (int l = 0; l < L; l += 8) {
+			__m256 h = _mm256_loadu_ps(newHeight + l), sp = _mm256_loadu_ps(speed + l), wa = _mm256_loadu_ps(water + l);
+			__m256 sed = _mm256_loadu_ps(sediment + l);
+			__m256 deltaH = _mm256_sub_ps(h, _mm256_loadu_ps(heightHere + l));
+			__m256 potential = _mm256_xor_ps(deltaH, signBit);
+			sp = _mm256_sqrt_ps(_mm256_max_ps(_mm256_add_ps(_mm256_mul_ps(sp, sp), _mm256_mul_ps(potential, gravity)), zero));
+			__m256 slope = _mm256_max_ps(_mm256_div_ps(potential, stepSize), minSlope);
+			__m256 capacity = _mm256_max_ps(_mm256_mul_ps(_mm256_mul_ps(_mm256_mul_ps(capacityFactor, sp), wa), slope), zero);
+
+			__m256 depositF = _mm256_mul_ps(depositRate, _mm256_sub_ps(sed, capacity));
+			__m256 deltaF = _mm256_mul_ps(capacityFactor, _mm256_sub_ps(capacity, sed));
+			__m256d deposit[2] = {widenLo(depositF), widenHi(depositF)}, erode[2] = {widenLo(deltaF), widenHi(deltaF)};
+			__m256d sedD[2] = {widenLo(sed), widenHi(sed)}, hD[2] = {widenLo(h), widenHi(h)};
+			__m256 depositing = _mm256_cmp_ps(sed, capacity, _CMP_GT_OQ);
+			__m256d depositingD[2] = {maskLo(depositing), maskHi(depositing)}, positive[2];
+			for (int k = 0; k < 2; k++) {
+				deposit[k] = _mm256_min_pd(sedD[k], deposit[k]);
+				erode[k] = _mm256_mul_pd(erodeRate, erode[k]);
+				erode[k] = _mm256_min_pd(maxErode, erode[k]);
+				erode[k] = _mm256_min_pd(_mm256_max_pd(hD[k], zeroD), erode[k]);
+				positive[k] = _mm256_cmp_pd(erode[k], zeroD, _CMP_GT_OQ);
+				_mm256_storeu_pd(amount + l + 4 * k, _mm256_blendv_pd(erode[k], deposit[k], depositingD[k]));
+			}
+			__m256 eroding = _mm256_andnot_ps(depositing, maskNarrow(positive[0], positive[1]));
+			__m256 alive = _mm256_castsi256_ps(_mm256_cmpgt_epi32(_mm256_loadu_si256((const __m256i *)(live + l)), _mm256_setzero_si256()));
+			__m256i kind = _mm256_or_si256(_mm256_and_si256(_mm256_castps_si256(depositing), _mm256_set1_epi32(1)),
+										   _mm256_and_si256(_mm256_castps_si256(eroding), _mm256_set1_epi32(2)));
+			_mm256_storeu_si256((__m256i *)(splat + l), _mm256_and_si256(kind, _mm256_castps_si256(alive)));
+			__m256 change = _mm256_blendv_ps(_mm256_and_ps(eroding, narrow(erode[0], erode[1])), _mm256_xor_ps(narrow(deposit[0], deposit[1]), signBit),
+											 depositing);
+			_mm256_storeu_ps(sediment + l, _mm256_blendv_ps(sed, _mm256_add_ps(sed, change), alive));
+			_mm256_storeu_ps(speed + l, sp);
+			_mm256_storeu_ps(water + l, _mm256_mul_ps(wa, keep));
+		}
+	}
+};
+
+// ---------------- AVX-512 (16 lanes) ----------------
+struct Avx512Lanes {
+	EROSION_AVX512 static inline __m512 clampCoord(__m512 v, __m512 hi) {
+		const __m512 zero = _mm512_setzero_ps();
+		v = _mm512_mask_blend_ps(_mm512_cmp_ps_mask(v, zero, _CMP_LT_OQ), v, zero);
+		return _mm512_mask_blend_ps(_mm512_cmp_ps_mask(v, hi, _CMP_GT_OQ), v, hi);
+	}
+
+	EROSION_AVX512 static inline void cellOf(int w, int h, __m512 fx, __m512 fy, __m512i &i00, __m512i &stepX, __m512i &stepY, __m512 &sx, __m512 &sy) {
+		__m512 px = clampCoord(fx, _mm512_set1_ps((float)(w - 1)));
+		__m512 py = clampCoord(fy, _mm512_set1_ps((float)(h - 1)));
+		__m512i x0 = _mm512_cvttps_epi32(px), y0 = _mm512_cvttps_epi32(py);
+		__m512i one = _mm512_set1_epi32(1);
+		__m512i x1 = _mm512_min_epi32(_mm512_add_epi32(x0, one), _mm512_set1_epi32(w - 1));
+		__m512i y1 = _mm512_min_epi32(_mm512_add_epi32(y0, one), _mm512_set1_epi32(h - 1));
+		sx = _mm512_sub_ps(px, _mm512_cvtepi32_ps(x0));
+		sy = _mm512_sub_ps(py, _mm512_cvtepi32_ps(y0));
+		__m512i vw = _mm512_set1_epi32(w);
+		i00 = _mm512_add_epi32(_mm512_mullo_epi32(y0, vw), x0);
+		stepX = _mm512_sub_epi32(x1, x0);
+		stepY = _mm512_mullo_epi32(_mm512_sub_epi32(y1, y0), vw);
+	}
+
+	EROSION_AVX512 static inline __m512 lerp(__m512 a, __m512 b, __m512 s) {
+		return _mm512_add_ps(_mm512_mul_ps(a, _mm512_sub_ps(_mm512_set1_ps(1.0f), s)), _mm512_mul_ps(b, s));
+	}
+
+	template <int L>
+	EROSION_AVX512 static void bilinear(const GridFloat &g, const float *fx, const float *fy, float *out) {
+		const float *d = g.data();
+		for (int l = 0; l < L; l += 16) {
+			__m512i i00, stepX, stepY;
+			__m512 sx, sy;
+			cellOf(g.width(), g.height(), _mm512_loadu_ps(fx + l), _mm512_loadu_ps(fy + l), i00, stepX, stepY, sx, sy);
+			__m512i i01 = _mm512_add_epi32(i00, stepY);
+			__m512 v00 = _mm512_i32gather_ps(i00, d, 4), v10 = _mm512_i32gather_ps(_mm512_add_epi32(i00, stepX), d, 4);
+			__m512 v01 = _mm512_i32gather_ps(i01, d, 4), v11 = _mm512_i32gather_ps(_mm512_add_epi32(i01, stepX), d, 4);
+			_mm512_storeu_ps(out + l, lerp(lerp(v00, v10, sx), lerp(v01, v11, sx), sy));
+		}
+	}
+
+	template <int L>
+	EROSION_AVX512 static void packed(const HeightSample *f, int w, int h, const float *fx, const float *fy, float *heightOut, float *gx, float *gy) {
+		const float *base = &f->h;
+		for (int l = 0; l < L; l += 16) {
+			__m512i i00, stepX, stepY;
+			__m512 sx, sy;
+			cellOf(w, h, _mm512_loadu_ps(fx + l), _mm512_loadu_ps(fy + l), i00, stepX, stepY, sx, sy);
+			__m512i c[4];
+			c[0] = _mm512_slli_epi32(i00, 2);
+			c[1] = _mm512_slli_epi32(_mm512_add_epi32(i00, stepX), 2);
+			c[2] = _mm512_slli_epi32(_mm512_add_epi32(i00, stepY), 2);
+			c[3] = _mm512_slli_epi32(_mm512_add_epi32(_mm512_add_epi32(i00, stepY), stepX), 2);
+			const __m512 one = _mm512_set1_ps(1.0f);
+			__m512 ox = _mm512_sub_ps(one, sx), oy = _mm512_sub_ps(one, sy);
+			__m512 wq[4] = {_mm512_mul_ps(ox, oy), _mm512_mul_ps(sx, oy), _mm512_mul_ps(ox, sy), _mm512_mul_ps(sx, sy)};
+			float *dst[3] = {heightOut + l, gx + l, gy + l};
+			for (int k = 0; k < 3; k++) {
+				__m512 acc = _mm512_mul_ps(_mm512_i32gather_ps(c[0], base + k, 4), wq[0]);
+				for (int q = 1; q < 4; q++) acc = _mm512_add_ps(acc, _mm512_mul_ps(_mm512_i32gather_ps(c[q], base + k, 4), wq[q]));
+				_mm512_storeu_ps(dst[k], acc);
+			}
+		}
+	}
+
+	template <int L>
+	EROSION_AVX512 static void direction(const ErosionParams &params, const float *gradX, const float *gradY, float *dirX, float *dirY, float *len) {
+		const __m512 inertia = _mm512_set1_ps(params.inertia), pull = _mm512_set1_ps(1.0f - params.inertia);
+		for (int l = 0; l < L; l += 16) {
+			__m512 dx = _mm512_sub_ps(_mm512_mul_ps(_mm512_loadu_ps(dirX + l), inertia), _mm512_mul_ps(_mm512_loadu_ps(gradX + l), pull));
+			__m512 dy = _mm512_sub_ps(_mm512_mul_ps(_mm512_loadu_ps(dirY + l), inertia), _mm512_mul_ps(_mm512_loadu_ps(gradY + l), pull));
+			_mm512_storeu_ps(dirX + l, dx);
+			_mm512_storeu_ps(dirY + l, dy);
+			_mm512_storeu_ps(len + l, _mm512_sqrt_ps(_mm512_add_ps(_mm512_mul_ps(dx, dx), _mm512_mul_ps(dy, dy))));
+		}
+	}
+
+	template <int L>
+	EROSION_AVX512 static void move(const ErosionParams &params, int W, int H, const float *len, float *dirX, float *dirY, float *x, float *y, int *live) {
+		const __m512 step = _mm512_set1_ps(params.stepSize), zero = _mm512_setzero_ps();
+		const __m512 maxX = _mm512_set1_ps((float)(W - 1)), maxY = _mm512_set1_ps((float)(H - 1));
+		for (int l = 0; l < L; l += 16) {
+			__m512i lv = _mm512_loadu_si512(live + l);
+			__mmask16 idle = _mm512_cmpeq_epi32_mask(lv, _mm512_setzero_si512());
+			__m512 inv = _mm512_mask_blend_ps(idle, _mm512_loadu_ps(len + l), _mm512_set1_ps(1.0f));
+			__m512 dx = _mm512_div_ps(_mm512_loadu_ps(dirX + l), inv), dy = _mm512_div_ps(_mm512_loadu_ps(dirY + l), inv);
+			__m512 px = _mm512_add_ps(_mm512_loadu_ps(x + l), _mm512_mul_ps(dx, step));
+			__m512 py = _mm512_add_ps(_mm512_loadu_ps(y + l), _mm512_mul_ps(dy, step));
+			__mmask16 outside = _mm512_cmp_ps_mask(px, zero, _CMP_LT_OQ) | _mm512_cmp_ps_mask(px, maxX, _CMP_GT_OQ) | _mm512_cmp_ps_mask(py, zero, _CMP_LT_OQ) |
+								_mm512_cmp_ps_mask(py, maxY, _CMP_GT_OQ);
+			_mm512_storeu_ps(dirX + l, dx);
+			_mm512_storeu_ps(dirY + l, dy);
+			_mm512_storeu_ps(x + l, px);
+			_mm512_storeu_ps(y + l, py);
+			_mm512_storeu_si512(live + l, _mm512_maskz_mov_epi32((__mmask16)~outside, lv));
+		}
+	}
+
+	// 16 floats <-> 2 x 8 doubles
+	EROSION_AVX512 static inline __m512d widenLo(__m512 v) { return _mm512_cvtps_pd(_mm512_castps512_ps256(v)); }
+	EROSION_AVX512 static inline __m512d widenHi(__m512 v) { return _mm512_cvtps_pd(_mm256_castpd_ps(_mm512_extractf64x4_pd(_mm512_castps_pd(v), 1))); }
+	EROSION_AVX512 static inline __m512 narrow(__m512d lo, __m512d hi) {
+		return _mm512_castpd_ps(_mm512_insertf64x4(_mm512_castpd256_pd512(_mm256_castps_pd(_mm512_cvtpd_ps(lo))), _mm256_castps_pd(_mm512_cvtpd_ps(hi)), 1));
+	}
+
+	template <int L>
+	EROSION_AVX512 static void transport(const ErosionParams &params, const int *live, const float *newHeight, const float *heightHere, float *speed,
+										 float *water, float *sediment, int *splat, double *amount) {
+		const __m512 zero = _mm512_setzero_ps(), signBit = _mm512_set1_ps(-0.0f);
+		const __m512 gravity = _mm512_set1_ps(params.gravity), stepSize = _mm512_set1_ps(params.stepSize), minSlope = _mm512_set1_ps(1e-6f);
+		const __m512 capacityFactor = _mm512_set1_ps(params.capacityFactor), depositRate = _mm512_set1_ps(params.depositRate);
+		const __m512 keep = _mm512_set1_ps(1.0f - params.evaporateRate);
+		const __m512d erodeRate = _mm512_set1_pd((double)params.erodeRate), maxErode = _mm512_set1_pd((double)params.maxErodePerStep);
+		const __m512d zeroD = _mm512_setzero_pd();
+		for (int l = 0; l < L; l += 16) {
+			__m512 h = _mm512_loadu_ps(newHeight + l), sp = _mm512_loadu_ps(speed + l), wa = _mm512_loadu_ps(water + l);
+			__m512 sed = _mm512_loadu_ps(sediment + l);
+			__m512 deltaH = _mm512_sub_ps(h, _mm512_loadu_ps(heightHere + l));
+			__m512 potential = _mm512_castsi512_ps(_mm512_xor_si512(_mm512_castps_si512(deltaH), _mm512_castps_si512(signBit)));
+			sp = _mm512_sqrt_ps(_mm512_max_ps(_mm512_add_ps(_mm512_mul_ps(sp, sp), _mm512_mul_ps(potential, gravity)), zero));
+			__m512 slope = _mm512_max_ps(_mm512_div_ps(potential, stepSize), minSlope);
+			__m512 capacity = _mm512_max_ps(_mm512_mul_ps(_mm512_mul_ps(_mm512_mul_ps(capacityFactor, sp), wa), slope), zero);
+
+			__m512 depositF = _mm512_mul_ps(depositRate, _mm512_sub_ps(sed, capacity));
+			__m512 deltaF = _mm512_mul_ps(capacityFactor, _mm512_sub_ps(capacity, sed));
+			__m512d deposit[2] = {widenLo(depositF), widenHi(depositF)}, erode[2] = {widenLo(deltaF), widenHi(deltaF)};
+			__m512d sedD[2] = {widenLo(sed), widenHi(sed)}, hD[2] = {widenLo(h), widenHi(h)};
+			__mmask16 depositing = _mm512_cmp_ps_mask(sed, capacity, _CMP_GT_OQ), positive = 0;
+			for (int k = 0; k < 2; k++) {
+				deposit[k] = _mm512_min_pd(sedD[k], deposit[k]);
+				erode[k] = _mm512_mul_pd(erodeRate, erode[k]);
+				erode[k] = _mm512_min_pd(maxErode, erode[k]);
+				erode[k] = _mm512_min_pd(_mm512_max_pd(hD[k], zeroD), erode[k]);
+				positive |= (__mmask16)_mm512_cmp_pd_mask(erode[k], zeroD, _CMP_GT_OQ) << (8 * k);
+				_mm512_storeu_pd(amount + l + 8 * k, _mm512_mask_blend_pd((__mmask8)(depositing >> (8 * k)), erode[k], deposit[k]));
+			}
+			__mmask16 eroding = (__mmask16)(~depositing & positive);
+			__mmask16 alive = _mm512_cmpgt_epi32_mask(_mm512_loadu_si512(live + l), _mm512_setzero_si512());
+			__m512i kind = _mm512_mask_mov_epi32(_mm512_maskz_mov_epi32(eroding, _mm512_set1_epi32(2)), depositing, _mm512_set1_epi32(1));
+			_mm512_storeu_si512(splat + l, _mm512_maskz_mov_epi32(alive, kind));
+			__m512 depositNeg = _mm512_castsi512_ps(_mm512_xor_si512(_mm512_castps_si512(narrow(deposit[0], deposit[1])), _mm512_castps_si512(signBit)));
+			__m512 change = _mm512_mask_blend_ps(depositing, _mm512_maskz_mov_ps(eroding, narrow(erode[0], erode[1])), depositNeg);
+			_mm512_storeu_ps(sediment + l, _mm512_mask_add_ps(sed, alive, sed, change));
+			_mm512_storeu_ps(speed + l, sp);
+			_mm512_storeu_ps(water + l, _mm512_mul_ps(wa, keep));
+		}
+	}
+};
+
+#endif	// EROSION_SIMD_X86
+
+template <int L, class Lanes>
+static inline void sampleHeightAndGradientLanes(const GridFloat &g, const float *fx, const float *fy, float *heightOut, float *gx, float *gy) {
+	const float eps = 1.0f;
+	alignas(64) float sx[L], sy[L], hi[L], lo[L];
+	Lanes::template bilinear<L>(g, fx, fy, heightOut);
+#pragma omp simd
+	for (int l = 0; l < L; l++) {
+		sx[l] = fx[l] + eps;
+		sy[l] = fx[l] - eps;
+	}
+	Lanes::template bilinear<L>(g, sx, fy, hi);
+	Lanes::template bilinear<L>(g, sy, fy, lo);
+#pragma omp simd
+	for (int l = 0; l < L; l++) {
+		gx[l] = (hi[l] - lo[l]) * 0.5f / eps;
+		sx[l] = fy[l] + eps;
+		sy[l] = fy[l] - eps;
+	}
+	Lanes::template bilinear<L>(g, fx, sx, hi);
+	Lanes::template bilinear<L>(g, fx, sy, lo);
+#pragma omp simd
+	for (int l = 0; l < L; l++) gy[l] = (hi[l] - lo[l]) * 0.5f / eps;
+}
+
+template <int L, class Lanes>
+static void simulateDropletsLockstep(const GridFloat &heightGrid, const HeightSample *packed, const ErosionParams &params, const int *ids, int count,
+									 const SplatTarget &out) {
+	const int W = heightGrid.width();
+	const int H = heightGrid.height();
+	alignas(64) float x[L], y[L], dirX[L], dirY[L], speed[L], water[L], sediment[L];
+	alignas(64) float heightHere[L], gradX[L], gradY[L], len[L], newHeight[L];
+	alignas(64) double amount[L], w00[L], w10[L], w01[L], w11[L];
+	alignas(64) size_t cell[L], stepX[L], stepY[L];
+	alignas(64) int steps[L], live[L];	// live: 0 empty lane, 1 running
+	alignas(64) int splat[L];			// after a step: 0 nothing, 1 deposit, 2 erode
+	rng_util::RNG rng[L];
+
+	int next = 0;
+	// next droplet of the list into lane l, or an idle lane parked on the map origin once it is empty
+	auto spawn = [&](int l) {
+		x[l] = y[l] = 0.0f;
+		dirX[l] = dirY[l] = 0.0f;
+		speed[l] = params.initSpeed;
+		water[l] = params.initWater;
+		sediment[l] = 0.0f;
+		steps[l] = 0;
+		live[l] = 0;
+		if (next >= count) return;
+		rng[l] = spawnDroplet(params, ids[next++], W, H, x[l], y[l]);
+		live[l] = params.maxSteps > 0;
+	};
+	int running = 0;
+	for (int l = 0; l < L; l++) {
+		do spawn(l);
+		while (!live[l] && next < count);
+		running += live[l];
+	}
+
+	while (running > 0) {
+		if (packed)
+			Lanes::template packed<L>(packed, W, H, x, y, heightHere, gradX, gradY);
+		else
+			sampleHeightAndGradientLanes<L, Lanes>(heightGrid, x, y, heightHere, gradX, gradY);
+
+		Lanes::template direction<L>(params, gradX, gradY, dirX, dirY, len);
+		for (int l = 0; l < L; l++) {
+			if (!live[l] || len[l] != 0.0f) continue;
+			double r = rng[l].nextFloat();
+			double theta = r * 2.0 * 3.141592653589793;
+			dirX[l] = (float)cos(theta) * 1e-6f;
+			dirY[l] = (float)sin(theta) * 1e-6f;
+			len[l] = sqrtf(dirX[l] * dirX[l] + dirY[l] * dirY[l]);
+		}
+		Lanes::template move<L>(params, W, H, len, dirX, dirY, x, y, live);
+
+		Lanes::template bilinear<L>(heightGrid, x, y, newHeight);
+		Lanes::template transport<L>(params, live, newHeight, heightHere, speed, water, sediment, splat, amount);
+
+		// quad cell and weights of every lane's splat in one simd pass (the accumulateToCellQuad
+		// expressions), then only the adds run lane by lane. brush erosion goes through its stencil
+#pragma omp simd
+		for (int l = 0; l < L; l++) {
+			float fxc = clampf(x[l], 0.0f, (float)(W - 1));
+			float fyc = clampf(y[l], 0.0f, (float)(H - 1));
+			int x0 = (int)fxc, y0 = (int)fyc;  // >= 0: truncation is floor
+			int x1 = std::min(x0 + 1, W - 1), y1 = std::min(y0 + 1, H - 1);
+			float sx = fxc - (float)x0, sy = fyc - (float)y0;
+			w00[l] = (1.0 - sx) * (1.0 - sy);
+			w10[l] = sx * (1.0 - sy);
+			w01[l] = (1.0 - sx) * sy;
+			w11[l] = sx * sy;
+			cell[l] = (size_t)(y0 - out.oy) * out.stride + (size_t)(x0 - out.ox);
+			stepX[l] = (size_t)(x1 - x0);
+			stepY[l] = (size_t)(y1 - y0) * out.stride;
+		}
+		for (int l = 0; l < L; l++) {
+			if (splat[l] == 0 || amount[l] == 0.0) continue;
+			if (splat[l] == 2 && out.brush) {
+				splatErosion(out, W, H, x[l], y[l], amount[l]);
+				continue;
+			}
+			double *c = (splat[l] == 1 ? out.deposit : out.erode) + cell[l];
+			c[0] += amount[l] * w00[l];
+			c[stepX[l]] += amount[l] * w10[l];
+			c[stepY[l]] += amount[l] * w01[l];
+			c[stepX[l] + stepY[l]] += amount[l] * w11[l];
+		}
+
+		running = 0;
+		for (int l = 0; l < L; l++) {
+			if (live[l]) live[l] = ++steps[l] < params.maxSteps && water[l] >= params.minWater && speed[l] >= params.minSpeed;
+			while (!live[l] && next < count) spawn(l);
+			running += live[l];
+		}
+	}
+}
+
+using LockstepFn = void (*)(const GridFloat &, const HeightSample *, const ErosionParams &, const int *, int, const SplatTarget &);
+
+#if EROSION_SIMD_X86
+// the whole lockstep loop under the lane isa's target, flatten pulls the driver and its lane calls in.
+// 8 lanes on an avx-512 host are one ymm, the avx2 kernel
+template <int L>
+EROSION_AVX2 __attribute__((flatten)) static void simulateDropletsLockstepAvx2(const GridFloat &heightGrid, const HeightSample *packed,
+																			   const ErosionParams &params, const int *ids, int count, const SplatTarget &out) {
+	simulateDropletsLockstep<L, Avx2Lanes>(heightGrid, packed, params, ids, count, out);
+}
+
+EROSION_AVX512 __attribute__((flatten)) static void simulateDropletsLockstepAvx512(const GridFloat &heightGrid, const HeightSample *packed,
+																				   const ErosionParams &params, const int *ids, int count, const SplatTarget &out) {
+	simulateDropletsLockstep<16, Avx512Lanes>(heightGrid, packed, params, ids, count, out);
+}
+#endif
+
+struct LockstepKernels {
+	const char *isa = "generic";
+	LockstepFn lanes8 = simulateDropletsLockstep<8, GenericLanes>;
+	LockstepFn lanes16 = simulateDropletsLockstep<16, GenericLanes>;
+};
+
+// best lane kernels for the host, picked once. TERRAIN_EROSION_ISA=generic|avx2|avx512 caps the level
+// (like TERRAIN_NOISE_ISA for the noise kernels)
+static LockstepKernels selectLockstepKernels() {
+	LockstepKernels k;
+#if EROSION_SIMD_X86
+	__builtin_cpu_init();
+	int level = __builtin_cpu_supports("avx512f") ? 2 : (__builtin_cpu_supports("avx2") ? 1 : 0);
+	if (const char *env = std::getenv("TERRAIN_EROSION_ISA")) {
+		int cap = level;
+		if (std::strcmp(env, "generic") == 0)
+			cap = 0;
+		else if (std::strcmp(env, "avx2") == 0)
+			cap = 1;
+		else if (std::strcmp(env, "avx512") == 0)
+			cap = 2;
+		level = std::min(level, cap);
+	}
+	if (level == 2)
+		k = {"avx512", simulateDropletsLockstepAvx2<8>, simulateDropletsLockstepAvx512};
+	else if (level == 1)
+		k = {"avx2", simulateDropletsLockstepAvx2<8>, simulateDropletsLockstepAvx2<16>};
+#endif
+	return k;
+}
+
+// the isa kernels index the packed field (4 floats per cell) with 32-bit gathers, bigger maps stay generic
+static const LockstepKernels &lockstepKernels(int W, int H) {
+	static const LockstepKernels best = selectLockstepKernels(), generic;
+	return (size_t)W * (size_t)H <= (size_t)std::numeric_limits<int>::max() / 4 ? best : generic;
+}
+
+// the droplets ids[0 .. count) one after the other, or in lockstep batches when params.dropletLanes asks for it
+static void simulateDroplets(const GridFloat &heightGrid, const HeightSample *packed, const ErosionParams &params, const int *ids, int count,
+							 const SplatTarget &out) {
+	const LockstepKernels &k = lockstepKernels(heightGrid.width(), heightGrid.height());
+	if (params.dropletLanes >= 16)
+		k.lanes16(heightGrid, packed, params, ids, count, out);
+	else if (params.dropletLanes >= 8)
+		k.lanes8(heightGrid, packed, params, ids, count, out);
+	else
+		for (int k = 0; k < count; k++) simulateDroplet(heightGrid, packed, params, ids[k], out);
+}
+
+// dst += sum of the per-thread partials. parallel over cache-sized cell blocks, so every thread streams
+// its own slice of dst and the partials; within a block the partials are added in thread order, so the
+// reduction is race free and does not depend on the schedule. it does depend on the thread count: which
+// droplets share a partial follows the static split of the droplets, so the double sums can round
+// differently with OMP_NUM_THREADS (the tile engine's do not)
+static void reducePartials(const vector<vector<double>> &parts, vector<double> &dst) {
+	constexpr size_t kBlock = 4096;	 // 32 KB of doubles
+	const size_t n = dst.size();
+	const long long nBlocks = (long long)((n + kBlock - 1) / kBlock);
 #pragma omp parallel for schedule(static)
-	for (int di = 0; di < N; di++) {
-		int tid = omp_get_thread_num();
-		ll seedState = params.worldSeed;
-		ll localState = seedState ^ (ll)di * 2654435761LL;
-		ll seed = rng_util::splitmix(localState);
-		rng_util::RNG rng(seed);
-
-		// initialize droplet
-		float x = rng.nextFloat() * (float)(W - 1);
-		float y = rng.nextFloat() * (float)(H - 1);
-		float dirX = 0.0f, dirY = 0.0f;
-		float speed = params.initSpeed;
-		float water = params.initWater;
-		float sediment = 0.0f;
-
-		for (int i = 0; i < maxSteps; i++) {
-			float heightHere, gradX, gradY;
-			sampleHeightAndGradient(heightGrid, x, y, heightHere, gradX, gradY);
+	for (long long b = 0; b < nBlocks; b++) {
+		const size_t i0 = (size_t)b * kBlock;
+		const size_t i1 = std::min(n, i0 + kBlock);
+		double *d = dst.data();
+		for (const auto &part : parts) {
+			const double *p = part.data();
+#pragma omp simd
+			for (size_t i = i0; i < i1; i++) d[i] += p[i];
+		}
+	}
+}
+
+// position of cell (x, y) along a space-filling curve over a 2^bits x 2^bits grid (bits <= 32).
+// the morton key does not need the size, bits above the coordinates are zero anyway
+static inline uint64_t mortonKey(uint32_t x, uint32_t y) {
+	auto spread = [](uint64_t v) {
+		v = (v | (v << 16)) & 0x0000FFFF0000FFFFull;
+		v = (v | (v << 8)) & 0x00FF00FF00FF00FFull;
+		v = (v | (v << 4)) & 0x0F0F0F0F0F0F0F0Full;
+		v = (v | (v << 2)) & 0x3333333333333333ull;
+		v = (v | (v << 1)) & 0x5555555555555555ull;
+		return v;
+	};
+	return spread(x) | (spread(y) << 1);
+}
 
-			// update direction: inertia + slope influence
-			dirX = dirX * params.inertia - gradX * (1.0f - params.inertia);
-			dirY = dirY * params.inertia - gradY * (1.0f - params.inertia);
-			float len = sqrtf(dirX * dirX + dirY * dirY);
-			if (len == 0.0f) {
-				double r = rng.nextFloat();
-				double theta = r * 2.0 * 3.141592653589793;
-				dirX = (float)cos(theta) * 1e-6f;
-				dirY = (float)sin(theta) * 1e-6f;
-				len = sqrtf(dirX * dirX + dirY * dirY);
+static inline uint64_t hilbertKey(uint32_t x, uint32_t y, int bits) {
+	uint64_t d = 0;
+	for (uint32_t s = 1u << (bits - 1); s > 0; s >>= 1) {
+		uint32_t rx = (x & s) ? 1 : 0;
+		uint32_t ry = (y & s) ? 1 : 0;
+		d += (uint64_t)s * s * ((3 * rx) ^ ry);
+		// rotate the quadrant so the curve stays continuous
+		if (ry == 0) {
+			if (rx == 1) {
+				x = s - 1 - (x & (s - 1));
+				y = s - 1 - (y & (s - 1));
 			}
-			dirX /= len;
-			dirY /= len;
+			std::swap(x, y);
+		}
+	}
+	return d;
+}
 
-			// move
-			x += dirX * params.stepSize;
-			y += dirY * params.stepSize;
+// droplets begin .. end - 1 ordered by spawn cell along the curve of params.dropletOrder (ties by index).
+// only the order changes, every droplet keeps its index keyed rng
+static vector<int> spatialDropletOrder(const ErosionParams &params, int begin, int end, int W, int H) {
+	const int count = end - begin;
+	// curve over the smallest power of two square holding the map, the batch index in the low bits of the
+	// sort key. if both don't fit in 64 bits the curve loses its finest levels: cells then group in small
+	// squares (ordered by index inside), which costs a little locality but never wraps the key
+	int bits = 1, indexBits = 1;
+	while (bits < 32 && (1ll << bits) < std::max(W, H)) bits++;
+	while (indexBits < 32 && (1ll << indexBits) < count) indexBits++;
+	const int coarsen = std::max(0, 2 * bits + indexBits - 64);
+	const int drop = coarsen + (coarsen & 1);  // whole levels of the curve
+	if (drop > 0) LOG_DEBUG("[EROSION] droplet order: curve coarsened by " << drop / 2 << " levels for a " << W << "x" << H << " map");
+	vector<uint64_t> keyed(count);
+#pragma omp parallel for schedule(static)
+	for (int k = 0; k < count; k++) {
+		float x, y;
+		spawnDroplet(params, begin + k, W, H, x, y);
+		// off-map spawns (they die on their first step) sort with the nearest edge cell
+		uint32_t cx = (uint32_t)std::clamp((int)std::floor(x), 0, W - 1);
+		uint32_t cy = (uint32_t)std::clamp((int)std::floor(y), 0, H - 1);
+		uint64_t key = params.dropletOrder == DropletOrder::Hilbert ? hilbertKey(cx, cy, bits) : mortonKey(cx, cy);
+		keyed[k] = ((key >> drop) << indexBits) | (uint64_t)k;
+	}
+	std::sort(keyed.begin(), keyed.end());
+	vector<int> ids(count);
+#pragma omp parallel for schedule(static)
+	for (int k = 0; k < count; k++) ids[k] = begin + (int)(keyed[k] & ((1ull << indexBits) - 1));
+	return ids;
+}
 
-			if (x < 0.0f || x > (W - 1) || y < 0.0f || y > (H - 1)) break;
+// time budget of a run: a batch runs in chunks (1 / kBudgetChunks of it) and a chunk only starts if it is
+// projected, from the time per droplet so far, to end within the budget. without a budget a batch is one chunk
+struct DropletBudget {
+	static constexpr int kBudgetChunks = 16;
+	double budgetMs = 0.0;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	long long dropletsRun = 0;
+	bool outOfTime = false;
 
-			float newHeight = sampleBilinear(heightGrid, x, y);
-			float deltaH = newHeight - heightHere;
+	double elapsedMs() const { return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count(); }
+	bool allows(int next) {
+		if (budgetMs <= 0.0 || dropletsRun == 0) return true;
+		double spent = elapsedMs();
+		if (spent + spent / (double)dropletsRun * next <= budgetMs) return true;
+		LOG_INFO("[EROSION] time budget reached after " << dropletsRun << " droplets (" << spent << " ms)");
+		outOfTime = true;
+		return false;
+	}
+};
 
-			float potential = -deltaH;	// downhill positive
-			speed = sqrtf(std::max(0.0f, speed * speed + potential * params.gravity));
+// fn(cb, ce) over the chunks of droplets begin .. end - 1 that the budget allows; returns the end of the last one run.
+// only the droplet work is chunked, the callers set up and reduce their buffers once around this
+template <class Fn>
+static int forEachBudgetChunk(DropletBudget &budget, int begin, int end, Fn &&fn) {
+	const int chunks = budget.budgetMs > 0.0 ? std::min(DropletBudget::kBudgetChunks, std::max(1, end - begin)) : 1;
+	int ran = begin;
+	for (int c = 0; c < chunks; c++) {
+		const int cb = begin + (int)((long long)(end - begin) * c / chunks);
+		const int ce = begin + (int)((long long)(end - begin) * (c + 1) / chunks);
+		if (!budget.allows(ce - cb)) break;
+		fn(cb, ce);
+		budget.dropletsRun += ce - cb;
+		ran = ce;
+	}
+	return ran;
+}
 
-			float slope = std::max(1e-6f, -deltaH / params.stepSize);
+// legacy engine: a full-grid erode + deposit buffer per thread, summed into epochErode/epochDeposit.
+// not reproducible across thread counts in the last bits, see reducePartials. returns the end of the
+// droplets run (end, unless the budget ran out)
+static int runBatchPerThread(const GridFloat &heightGrid, const HeightSample *packed, const ErosionParams &params, const ErosionBrush *brush, int begin, int end,
+							 DropletBudget &budget, vector<vector<double>> &erodeBufs, vector<vector<double>> &depositBufs, vector<double> &epochErode,
+							 vector<double> &epochDeposit, logging::Progress &progress) {
+	const int W = heightGrid.width();
+	const size_t nCells = epochErode.size();
+	const int numThreads = (int)erodeBufs.size();
+	for (int t = 0; t < numThreads; t++) {
+		erodeBufs[t].assign(nCells, 0.0);
+		depositBufs[t].assign(nCells, 0.0);
+	}
+	LOG_DEBUG("[EROSION] droplets " << begin << " .. " << end << " on " << numThreads << " per-thread buffers");
 
-			float capacity = std::max(0.0f, params.capacityFactor * speed * water * slope);
-
-			if (sediment > capacity) {
-				double deposit = params.depositRate * (sediment - capacity);
-				deposit = std::min<double>(deposit, sediment);
-				accumulateToCellQuad(depositBufs[tid], W, H, x, y, deposit);
-				sediment -= (float)deposit;
-			} else {
-				double delta = params.capacityFactor * (capacity - sediment);
-				double erode = params.erodeRate * delta;
-				erode = std::min(erode, (double)params.maxErodePerStep);
-				double localHeight = newHeight;
-				erode = std::min(erode, std::max(0.0, localHeight));
-				if (erode > 0.0) {
-					accumulateToCellQuad(erodeBufs[tid], W, H, x, y, erode);
-					sediment += (float)erode;
+	const int ran = forEachBudgetChunk(budget, begin, end, [&](int cb, int ce) {
+		// static schedule over the curve order: every thread gets one contiguous patch of the map
+		const vector<int> sorted = params.dropletOrder == DropletOrder::Index ? vector<int>() : spatialDropletOrder(params, cb, ce, W, heightGrid.height());
+		if (!sorted.empty() && params.dropletLanes < 8) {
+			constexpr int kReport = 4096;
+#pragma omp parallel for schedule(static)
+			for (int k = 0; k < (int)sorted.size(); k++) {
+				int tid = omp_get_thread_num();
+				simulateDroplet(heightGrid, packed, params, sorted[k], SplatTarget{erodeBufs[tid].data(), depositBufs[tid].data(), 0, 0, (size_t)W, brush});
+				if (k % kReport == kReport - 1) progress.add(kReport);
+			}
+			progress.add((int)sorted.size() % kReport);
+		} else if (params.dropletLanes < 8) {
+			constexpr int kReport = 4096;  // droplets per progress update
+#pragma omp parallel for schedule(static)
+			for (int di = cb; di < ce; di++) {
+				int tid = omp_get_thread_num();
+				simulateDroplet(heightGrid, packed, params, di, SplatTarget{erodeBufs[tid].data(), depositBufs[tid].data(), 0, 0, (size_t)W, brush});
+				if ((di - cb) % kReport == kReport - 1) progress.add(kReport);
+			}
+			progress.add((ce - cb) % kReport);
+		} else {
+			// lockstep lanes want a list of droplets, hand them out in chunks
+			constexpr int kChunk = 1024;
+#pragma omp parallel
+			{
+				int ids[kChunk];
+				int tid = omp_get_thread_num();
+				SplatTarget target{erodeBufs[tid].data(), depositBufs[tid].data(), 0, 0, (size_t)W, brush};
+#pragma omp for schedule(static)
+				for (int c = cb; c < ce; c += kChunk) {
+					int n = std::min(kChunk, ce - c);
+					for (int k = 0; k < n; k++) ids[k] = sorted.empty() ? c + k : sorted[c - cb + k];
+					simulateDroplets(heightGrid, packed, params, ids, n, target);
+					progress.add(n);
 				}
 			}
+		}
+	});
+
+	reducePartials(erodeBufs, epochErode);
+	reducePartials(depositBufs, epochDeposit);
+	return ran;
+}
+
+// reach of a droplet's splats from its spawn point, in cells
+static inline int dropletHalo(const ErosionParams &params, const ErosionBrush &brush) {
+	return (int)std::ceil((float)params.maxSteps * std::fabs(params.stepSize)) + 2 + brush.reach;
+}
+
+// tile engine: droplets are bucketed by spawn tile and a thread runs one tile at a time, splatting
+// straight into the epoch buffers. tiles are at least two halos wide and run in 2x2 colour phases, so
+// the tile + halo footprints of one phase never overlap: no locks, no per-thread buffers, and every
+// cell receives its contributions in the same order whatever the thread count. returns the end of the
+// droplets run (end, unless the budget ran out)
+static int runBatchTiled(const GridFloat &heightGrid, const HeightSample *packed, const ErosionParams &params, const ErosionBrush &brush, int begin, int end,
+						 DropletBudget &budget, vector<double> &epochErode, vector<double> &epochDeposit, logging::Progress &progress) {
+	const int W = heightGrid.width();
+	const int H = heightGrid.height();
+	const int halo = dropletHalo(params, brush);
+	const int T = std::max(std::max(16, params.tileSize), 2 * halo);
+	const int tilesX = (W + T - 1) / T, tilesY = (H + T - 1) / T;
+	const int nTiles = tilesX * tilesY;
+	LOG_DEBUG("[EROSION] droplets " << begin << " .. " << end << " on " << tilesX << "x" << tilesY << " tiles of " << T << " + halo " << halo);
+	const SplatTarget target{epochErode.data(), epochDeposit.data(), 0, 0, (size_t)W, brush.enabled() ? &brush : nullptr};
+	vector<int> tileOf, tileStart(nTiles + 1), order, fill(nTiles);
+
+	return forEachBudgetChunk(budget, begin, end, [&](int cb, int ce) {
+		// counting sort of the chunk by spawn tile, stable in droplet index (or in curve order, so the
+		// droplets of a tile also run patch by patch)
+		const int count = ce - cb;
+		const vector<int> sorted = params.dropletOrder == DropletOrder::Index ? vector<int>() : spatialDropletOrder(params, cb, ce, W, H);
+		auto dropletAt = [&](int k) { return sorted.empty() ? cb + k : sorted[k]; };
+		tileOf.resize(count);
+		order.resize(count);
+#pragma omp parallel for schedule(static)
+		for (int k = 0; k < count; k++) {
+			float x, y;
+			spawnDroplet(params, dropletAt(k), W, H, x, y);
+			// spawns can lie off the map (those die on their first step), clamp them into the edge tiles
+			int tx = std::clamp((int)std::floor(x) / T, 0, tilesX - 1), ty = std::clamp((int)std::floor(y) / T, 0, tilesY - 1);
+			tileOf[k] = ty * tilesX + tx;
+		}
+		std::fill(tileStart.begin(), tileStart.end(), 0);
+		for (int k = 0; k < count; k++) tileStart[tileOf[k] + 1]++;
+		for (int t = 0; t < nTiles; t++) tileStart[t + 1] += tileStart[t];
+		std::copy(tileStart.begin(), tileStart.end() - 1, fill.begin());
+		for (int k = 0; k < count; k++) order[fill[tileOf[k]]++] = dropletAt(k);
 
-			water *= (1.0f - params.evaporateRate);
-			if (water < params.minWater) break;
-			if (speed < params.minSpeed) break;
-			std::cerr << "[ERODE DEBUG] droplet loop completed, starting reduction ..." << std::endl;
+		for (int phase = 0; phase < 4; phase++) {
+#pragma omp parallel for schedule(dynamic, 1)
+			for (int t = 0; t < nTiles; t++) {
+				int tx = t % tilesX, ty = t / tilesX;
+				if ((tx & 1) != (phase & 1) || (ty & 1) != (phase >> 1)) continue;
+				if (tileStart[t] == tileStart[t + 1]) continue;
+				simulateDroplets(heightGrid, packed, params, order.data() + tileStart[t], tileStart[t + 1] - tileStart[t], target);
+				progress.add(tileStart[t + 1] - tileStart[t]);
+			}
 		}
-	}
+	});
+}
+
+ErosionStats runHydraulicErosion(GridFloat &heightGrid, const ErosionParams &params, GridFloat *outEroded, GridFloat *outDeposited) {
+	if (params.model == ErosionModel::Pipe) return runPipeErosion(heightGrid, params, outEroded, outDeposited);
+	if (params.pyramidLevels > 0) return runPyramidErosion(heightGrid, params, outEroded, outDeposited);
+
+	int W = heightGrid.width();
+	int H = heightGrid.height();
+	const int N = params.numDroplets;
+	const int epochs = std::max(1, std::min(params.epochs, std::max(1, N)));
+
+	// per-thread full grids, only for the legacy engine
+	const int numThreads = params.usePerThreadBuffers ? omp_get_max_threads() : 0;
+	vector<vector<double>> erodeBufs(numThreads), depositBufs(numThreads);
+	const size_t nCells = (size_t)W * (size_t)H;
+	ErosionBrush brush = ErosionBrush::make(params.erosionRadius);
+	brush.setStride((size_t)W);
 
 	ErosionStats stats;
-	vector<double> finalErode(nCells, 0.0), finalDeposit(nCells, 0.0);
+	// totals over all epochs for the eroded / deposited maps; epochErode/epochDeposit hold one batch
+	vector<double> finalErode(epochs > 1 ? nCells : 0, 0.0), finalDeposit(epochs > 1 ? nCells : 0, 0.0);
+	vector<double> epochErode(nCells), epochDeposit(nCells);
+	vector<double> rowEroded(H), rowDeposited(H), rowChange(H);
+	logging::Progress progress("[EROSION] droplets", N);
+	vector<HeightSample> samples;
+	if (params.dropletLanes >= 8) LOG_DEBUG("[EROSION] lockstep lanes: " << (params.dropletLanes >= 16 ? 16 : 8) << " (" << lockstepKernels(W, H).isa << ")");
+	if (params.convergeEpsilon > 0.0f && epochs == 1) LOG_WARN("[EROSION] convergeEpsilon is tested between epochs, it does nothing with a single epoch");
+	DropletBudget budget;
+	budget.budgetMs = params.timeBudgetMs;
+
+	for (int e = 0; e < epochs && !budget.outOfTime; e++) {
+		// contiguous droplet index ranges, so every droplet keeps its seed whatever the epoch count
+		const int begin = (int)((long long)N * e / epochs);
+		const int end = (int)((long long)N * (e + 1) / epochs);
+
+		// the packed field follows the height, rebuilt once per epoch
+		if (params.packedGradient) buildHeightSamples(heightGrid, samples);
+		const HeightSample *packed = params.packedGradient ? samples.data() : nullptr;
+
+		std::fill(epochErode.begin(), epochErode.end(), 0.0);
+		std::fill(epochDeposit.begin(), epochDeposit.end(), 0.0);
+		const int ran = params.usePerThreadBuffers ? runBatchPerThread(heightGrid, packed, params, brush.enabled() ? &brush : nullptr, begin, end, budget,
+																	   erodeBufs, depositBufs, epochErode, epochDeposit, progress)
+												   : runBatchTiled(heightGrid, packed, params, brush, begin, end, budget, epochErode, epochDeposit, progress);
+		if (ran == begin) break;
+
+		// apply the batch; totals per row, then added in row order so they don't depend on the schedule
 #pragma omp parallel for schedule(static)
-	for (int t = 0; t < numThreads; t++) {
-		const auto &eb = erodeBufs[t];
-		const auto &db = depositBufs[t];
-		for (size_t i = 0; i < nCells; i++) {
-			finalErode[i] += eb[i];
-			finalDeposit[i] += db[i];
+		for (int y = 0; y < H; y++) {
+			const double *er = epochErode.data() + (size_t)y * W;
+			const double *de = epochDeposit.data() + (size_t)y * W;
+			float *row = heightGrid.data() + (size_t)y * W;
+			double eroded = 0.0, deposited = 0.0, change = 0.0;
+#pragma omp simd reduction(+ : eroded, deposited, change)
+			for (int x = 0; x < W; x++) {
+				eroded += er[x];
+				deposited += de[x];
+				double newH = (double)row[x] + (de[x] - er[x]);
+				float h = (float)(newH < 0.0 ? 0.0 : newH);
+				change += std::fabs((double)h - (double)row[x]);
+				row[x] = h;
+			}
+			rowEroded[y] = eroded;
+			rowDeposited[y] = deposited;
+			rowChange[y] = change;
 		}
-	}
+		double change = 0.0;
+		for (int y = 0; y < H; y++) {
+			stats.totalEroded += rowEroded[y];
+			stats.totalDeposited += rowDeposited[y];
+			change += rowChange[y];
+		}
+		const double meanDelta = change / (double)nCells;
+		stats.epochMeanDelta.push_back(meanDelta);
+		stats.appliedDroplets += ran - begin;
+		stats.epochs = e + 1;
+		LOG_DEBUG("[EROSION] epoch " << e + 1 << "/" << epochs << ": droplets=" << ran - begin << " meanDelta=" << meanDelta);
 
-#pragma omp parallel for collapse(2) schedule(static)
-	for (int y = 0; y < H; y++) {
-		for (int x = 0; x < W; x++) {
-			size_t idx = (size_t)y * W + x;
-			double delta = finalDeposit[idx] - finalErode[idx];
-			stats.totalEroded += finalErode[idx];
-			stats.totalDeposited += finalDeposit[idx];
-			double newH = (double)heightGrid(x, y) + delta;
-			if (newH < 0.0) newH = 0.0;
-			heightGrid(x, y) = (float)newH;
+		if (epochs > 1) {
+#pragma omp parallel for schedule(static)
+			for (size_t i = 0; i < nCells; i++) {
+				finalErode[i] += epochErode[i];
+				finalDeposit[i] += epochDeposit[i];
+			}
 		}
+
+		if (params.convergeEpsilon > 0.0f && meanDelta < params.convergeEpsilon) {
+			if (e + 1 < epochs) LOG_INFO("[EROSION] converged after " << e + 1 << "/" << epochs << " epochs (meanDelta=" << meanDelta << ")");
+			break;
+		}
+	}
+	stats.elapsedMs = budget.elapsedMs();
+	logging::flush();  // progress lines buffered by the worker threads
+	if (epochs == 1) {
+		finalErode.swap(epochErode);
+		finalDeposit.swap(epochDeposit);
 	}
 
 	if (outEroded) {
@@ -214,7 +1248,6 @@ ErosionStats runHydraulicErosion(GridFloat &heightGrid, const ErosionParams &par
 			for (int x = 0; x < W; x++) (*outDeposited)(x, y) = (float)finalDeposit[(size_t)y * W + x];
 	}
 
-	stats.appliedDroplets = N;
 	return stats;
 }
-}  // namespace erosion
\ No newline at end of file
+}  // namespace erosion
@@ -1,5 +1,6 @@
 #pragma once
 #include <string>
+#include <vector>
 
 #include "ErosionParams.h"
 #include "Types.h"
@@ -10,6 +11,9 @@ struct ErosionStats {
 	double totalEroded = 0.0;
 	double totalDeposited = 0.0;
 	int appliedDroplets = 0;
+	int epochs = 0;			// epochs that ran, fewer than params.epochs if a run mode stopped early
+	double elapsedMs = 0.0;
+	std::vector<double> epochMeanDelta;	 // mean |height change| per cell of each epoch (convergence curve)
 };
 
 ErosionStats runHydraulicErosion(GridFloat &heightGrid, const ErosionParams &params, GridFloat *outEroded = nullptr, GridFloat *outDeposited = nullptr);
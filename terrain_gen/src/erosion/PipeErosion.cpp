@@ -0,0 +1,297 @@
+#include "PipeErosion.h"
+
+#include <omp.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <utility>
+#include <vector>
+
+#include "Log.h"
+
+namespace erosion {
+
+// the grids one iteration works on. plain pointers so the ping-pong pairs swap without touching the
+// GridFloat objects (the caller's height grid keeps its storage)
+struct PipeFields {
+	int W = 0, H = 0;
+	float *height = nullptr, *heightNext = nullptr;
+	float *water = nullptr, *waterNext = nullptr;
+	float *sediment = nullptr, *moved = nullptr;
+	float *velX = nullptr, *velY = nullptr;
+	float *fluxL = nullptr, *fluxR = nullptr, *fluxU = nullptr, *fluxD = nullptr;  // outflow towards x-1, x+1, y-1, y+1
+	float *eroded = nullptr, *deposited = nullptr;
+};
+
+struct PipeConsts {
+	float dt, len, area, rain, fluxGain, damping, keep;
+};
+
+// new outflow of (x, y) through its 4 pipes, scaled so it never drains more than the cell holds.
+// Checked = closed border, only needed on the map border
+template <bool Checked>
+static inline void outflow(const PipeFields &f, const PipeConsts &c, int x, int y) {
+	const int W = f.W, H = f.H;
+	const size_t i = (size_t)y * W + x;
+	const float hc = f.height[i] + f.water[i];
+	auto pipe = [&](float flux, int nx, int ny) {
+		if (Checked && (nx < 0 || ny < 0 || nx >= W || ny >= H)) return 0.0f;
+		const size_t n = (size_t)ny * W + nx;
+		return std::max(0.0f, flux * c.damping + c.fluxGain * (hc - f.height[n] - f.water[n]));
+	};
+	float l = pipe(f.fluxL[i], x - 1, y);
+	float r = pipe(f.fluxR[i], x + 1, y);
+	float u = pipe(f.fluxU[i], x, y - 1);
+	float d = pipe(f.fluxD[i], x, y + 1);
+	float total = (l + r + u + d) * c.dt;
+	float d1 = f.water[i] + c.rain;
+	if (total > d1 * c.area) {
+		float k = total > 0.0f ? d1 * c.area / total : 0.0f;
+		l *= k;
+		r *= k;
+		u *= k;
+		d *= k;
+	}
+	f.fluxL[i] = l;
+	f.fluxR[i] = r;
+	f.fluxU[i] = u;
+	f.fluxD[i] = d;
+}
+
+// water height and velocity of (x, y) from the net flux through it, and the sediment the water carries in and out
+template <bool Checked>
+static inline void transport(const PipeFields &f, const PipeConsts &c, int x, int y) {
+	const int W = f.W, H = f.H;
+	const size_t i = (size_t)y * W + x;
+	// share of cell n's water that one of its pipes moves this step
+	auto share = [&](float flux, size_t n) {
+		float d1 = f.water[n] + c.rain;
+		return d1 > 0.0f ? flux * c.dt / (d1 * c.area) : 0.0f;
+	};
+	const bool hasL = !Checked || x > 0, hasR = !Checked || x < W - 1;
+	const bool hasU = !Checked || y > 0, hasD = !Checked || y < H - 1;
+	float inL = hasL ? f.fluxR[i - 1] : 0.0f;
+	float inR = hasR ? f.fluxL[i + 1] : 0.0f;
+	float inU = hasU ? f.fluxD[i - W] : 0.0f;
+	float inD = hasD ? f.fluxU[i + W] : 0.0f;
+	float out = f.fluxL[i] + f.fluxR[i] + f.fluxU[i] + f.fluxD[i];
+	float d1 = f.water[i] + c.rain;
+	float d2 = std::max(0.0f, d1 + c.dt * (inL + inR + inU + inD - out) / c.area);
+	float mean = 0.5f * (d1 + d2);
+	float wx = 0.5f * (inL - f.fluxL[i] + f.fluxR[i] - inR);
+	float wy = 0.5f * (inU - f.fluxU[i] + f.fluxD[i] - inD);
+	f.velX[i] = mean > 1e-4f ? wx / (mean * c.len) : 0.0f;
+	f.velY[i] = mean > 1e-4f ? wy / (mean * c.len) : 0.0f;
+	f.waterNext[i] = d2;
+
+	float s = f.sediment[i] * std::max(0.0f, 1.0f - share(out, i));
+	if (hasL) s += f.sediment[i - 1] * share(inL, i - 1);
+	if (hasR) s += f.sediment[i + 1] * share(inR, i + 1);
+	if (hasU) s += f.sediment[i - W] * share(inU, i - W);
+	if (hasD) s += f.sediment[i + W] * share(inD, i + W);
+	f.moved[i] = s;
+}
+
+// dissolve below the carrying capacity of (x, y), settle above it. Checked clamps the gradient stencil at the border
+template <bool Checked>
+static inline void erodeDeposit(const PipeFields &f, const PipeConsts &c, const ErosionParams &params, int x, int y) {
+	const int W = f.W, H = f.H;
+	const size_t i = (size_t)y * W + x;
+	const float *h = f.height;
+	const size_t l = Checked ? (size_t)y * W + std::max(x - 1, 0) : i - 1;
+	const size_t r = Checked ? (size_t)y * W + std::min(x + 1, W - 1) : i + 1;
+	const size_t u = Checked ? (size_t)std::max(y - 1, 0) * W + x : i - W;
+	const size_t d = Checked ? (size_t)std::min(y + 1, H - 1) * W + x : i + W;
+	float b = h[i];
+	float gx = (h[r] - h[l]) * 0.5f / c.len;
+	float gy = (h[d] - h[u]) * 0.5f / c.len;
+	float g2 = gx * gx + gy * gy;
+	float tilt = std::max(params.pipeMinTilt, std::sqrt(g2 / (1.0f + g2)));
+	float speed = std::sqrt(f.velX[i] * f.velX[i] + f.velY[i] * f.velY[i]);
+	// thin films carry little: capacity ramps in over the first pipeDepthScale of water
+	float depth = std::min(1.0f, f.water[i] / params.pipeDepthScale);
+	float capacity = params.pipeCapacity * tilt * speed * depth;
+	float s = f.sediment[i];
+	// both amounts, then a select: the interior loop vectorises
+	float dissolve = std::min(std::min(params.pipeDissolve * (capacity - s) * c.dt, params.maxErodePerStep), std::max(0.0f, b));
+	float settle = params.pipeDeposit * (s - capacity) * c.dt;
+	bool erodes = capacity > s;
+	f.heightNext[i] = erodes ? b - dissolve : b + settle;
+	f.sediment[i] = erodes ? s + dissolve : s - settle;
+	f.eroded[i] += erodes ? dissolve : 0.0f;
+	f.deposited[i] += erodes ? 0.0f : settle;
+	f.water[i] *= c.keep;
+}
+
+// one step of the model: three stencil sweeps, each bounds-checked only on the border rows and columns
+static void pipeIteration(PipeFields &f, const PipeConsts &c, const ErosionParams &params) {
+	const int W = f.W, H = f.H;
+
+	// rain is uniform, so it cancels out of the height differences and only enters through the
+	// water a cell can give away (d1) and the water update below
+#pragma omp parallel for schedule(static)
+	for (int y = 0; y < H; y++) {
+		if (y == 0 || y == H - 1 || W < 3) {
+			for (int x = 0; x < W; x++) outflow<true>(f, c, x, y);
+			continue;
+		}
+		outflow<true>(f, c, 0, y);
+#pragma omp simd
+		for (int x = 1; x < W - 1; x++) outflow<false>(f, c, x, y);
+		outflow<true>(f, c, W - 1, y);
+	}
+
+	// suspended sediment moves with the water: a pipe carrying a fraction of a cell's water carries the
+	// same fraction of its sediment, which keeps the transport mass conserving
+#pragma omp parallel for schedule(static)
+	for (int y = 0; y < H; y++) {
+		if (y == 0 || y == H - 1 || W < 3) {
+			for (int x = 0; x < W; x++) transport<true>(f, c, x, y);
+			continue;
+		}
+		transport<true>(f, c, 0, y);
+#pragma omp simd
+		for (int x = 1; x < W - 1; x++) transport<false>(f, c, x, y);
+		transport<true>(f, c, W - 1, y);
+	}
+	std::swap(f.water, f.waterNext);
+	std::swap(f.sediment, f.moved);
+
+	// capacity from local tilt and speed. reads the terrain neighbourhood, so the new terrain goes to a second buffer
+#pragma omp parallel for schedule(static)
+	for (int y = 0; y < H; y++) {
+		if (y == 0 || y == H - 1 || W < 3) {
+			for (int x = 0; x < W; x++) erodeDeposit<true>(f, c, params, x, y);
+			continue;
+		}
+		erodeDeposit<true>(f, c, params, 0, y);
+#pragma omp simd
+		for (int x = 1; x < W - 1; x++) erodeDeposit<false>(f, c, params, x, y);
+		erodeDeposit<true>(f, c, params, W - 1, y);
+	}
+	std::swap(f.height, f.heightNext);
+}
+
+ErosionStats runPipeErosion(GridFloat &heightGrid, const ErosionParams &params, GridFloat *outEroded, GridFloat *outDeposited) {
+	const int W = heightGrid.width();
+	const int H = heightGrid.height();
+	ErosionStats stats;
+	if (W <= 0 || H <= 0) return stats;
+	const auto start = std::chrono::steady_clock::now();
+	auto elapsedMs = [&] { return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count(); };
+
+	PipeConsts c;
+	c.dt = params.pipeTimeStep;
+	c.len = params.pipeLength;	 // pipe length = cell spacing
+	c.area = c.len * c.len;		 // pipe cross-section and cell footprint
+	c.rain = c.dt * params.pipeRain;
+	c.fluxGain = c.dt * c.area * params.gravity / c.len;
+	c.damping = std::max(0.0f, 1.0f - params.pipeFriction * c.dt);
+	c.keep = std::max(0.0f, 1.0f - params.pipeEvaporation * c.dt);
+
+	GridFloat water(W, H, 0.0f), waterNext(W, H), sediment(W, H, 0.0f), moved(W, H), terrain(W, H), epochStart(W, H);
+	GridFloat velX(W, H, 0.0f), velY(W, H, 0.0f);
+	GridFloat fluxL(W, H, 0.0f), fluxR(W, H, 0.0f), fluxU(W, H, 0.0f), fluxD(W, H, 0.0f);
+	GridFloat eroded(W, H, 0.0f), deposited(W, H, 0.0f);
+	PipeFields f;
+	f.W = W;
+	f.H = H;
+	f.height = heightGrid.data();
+	f.heightNext = terrain.data();
+	f.water = water.data();
+	f.waterNext = waterNext.data();
+	f.sediment = sediment.data();
+	f.moved = moved.data();
+	f.velX = velX.data();
+	f.velY = velY.data();
+	f.fluxL = fluxL.data();
+	f.fluxR = fluxR.data();
+	f.fluxU = fluxU.data();
+	f.fluxD = fluxD.data();
+	f.eroded = eroded.data();
+	f.deposited = deposited.data();
+
+	// run modes as for the droplets: the iterations split into epochs, the time budget checked before every
+	// iteration and the convergence test between epochs
+	const size_t nCells = (size_t)W * (size_t)H;
+	const int iterations = std::max(0, params.pipeIterations);
+	const int epochs = std::max(1, std::min(params.epochs, std::max(1, iterations)));
+	if (params.convergeEpsilon > 0.0f && epochs == 1) LOG_WARN("[EROSION] convergeEpsilon is tested between epochs, it does nothing with a single epoch");
+	std::vector<double> rowEroded(H), rowDeposited(H), rowChange(H);
+	int done = 0;
+	bool outOfTime = false;
+	for (int e = 0; e < epochs && !outOfTime; e++) {
+		const int begin = (int)((long long)iterations * e / epochs);
+		const int end = (int)((long long)iterations * (e + 1) / epochs);
+		std::copy(f.height, f.height + nCells, epochStart.data());
+		int it = begin;
+		for (; it < end; it++) {
+			if (params.timeBudgetMs > 0.0 && done > 0) {
+				double spent = elapsedMs();
+				if (spent + spent / done > params.timeBudgetMs) {
+					LOG_INFO("[EROSION] time budget reached after " << done << " pipe iterations (" << spent << " ms)");
+					outOfTime = true;
+					break;
+				}
+			}
+			pipeIteration(f, c, params);
+			done++;
+		}
+		if (it == begin) break;
+
+		// per row, then added in row order so the curve doesn't depend on the thread count
+#pragma omp parallel for schedule(static)
+		for (int y = 0; y < H; y++) {
+			const float *now = f.height + (size_t)y * W;
+			const float *was = epochStart.data() + (size_t)y * W;
+			double change = 0.0;
+#pragma omp simd reduction(+ : change)
+			for (int x = 0; x < W; x++) change += std::fabs((double)now[x] - (double)was[x]);
+			rowChange[y] = change;
+		}
+		double change = 0.0;
+		for (int y = 0; y < H; y++) change += rowChange[y];
+		const double meanDelta = change / (double)nCells;
+		stats.epochMeanDelta.push_back(meanDelta);
+		stats.epochs = e + 1;
+		LOG_DEBUG("[EROSION] epoch " << e + 1 << "/" << epochs << ": pipe iterations=" << it - begin << " meanDelta=" << meanDelta);
+
+		if (params.convergeEpsilon > 0.0f && meanDelta < params.convergeEpsilon) {
+			if (e + 1 < epochs) LOG_INFO("[EROSION] converged after " << e + 1 << "/" << epochs << " epochs (meanDelta=" << meanDelta << ")");
+			break;
+		}
+	}
+	if (f.height != heightGrid.data()) std::copy(f.height, f.height + nCells, heightGrid.data());
+
+	// whatever is still suspended settles where it is. totals per row, added in row order
+	const float *sed = f.sediment;
+#pragma omp parallel for schedule(static)
+	for (int y = 0; y < H; y++) {
+		float *row = heightGrid.data() + (size_t)y * W;
+		const float *s = sed + (size_t)y * W;
+		const float *er = eroded.data() + (size_t)y * W;
+		float *de = deposited.data() + (size_t)y * W;
+		double rowEr = 0.0, rowDe = 0.0;
+#pragma omp simd reduction(+ : rowEr, rowDe)
+		for (int x = 0; x < W; x++) {
+			row[x] += s[x];
+			de[x] += s[x];
+			rowEr += er[x];
+			rowDe += de[x];
+		}
+		rowEroded[y] = rowEr;
+		rowDeposited[y] = rowDe;
+	}
+	for (int y = 0; y < H; y++) {
+		stats.totalEroded += rowEroded[y];
+		stats.totalDeposited += rowDeposited[y];
+	}
+	stats.elapsedMs = elapsedMs();
+
+	if (outEroded) *outEroded = std::move(eroded);
+	if (outDeposited) *outDeposited = std::move(deposited);
+	return stats;
+}
+
+}  // namespace erosion
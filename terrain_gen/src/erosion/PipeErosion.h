@@ -0,0 +1,15 @@
+#pragma once
+
+#include "ErosionParams.h"
+#include "HydraulicErosion.h"
+#include "Types.h"
+
+namespace erosion {
+
+// grid based shallow-water erosion (virtual pipe model): every cell holds water and suspended sediment
+// and exchanges water with its 4 neighbours through pipes. each iteration is a handful of full-grid
+// stencil sweeps (flux, water + velocity, erode / deposit, sediment advection), no random access.
+// picked by runHydraulicErosion when params.model == ErosionModel::Pipe
+ErosionStats runPipeErosion(GridFloat &heightGrid, const ErosionParams &params, GridFloat *outEroded = nullptr, GridFloat *outDeposited = nullptr);
+
+}  // namespace erosion
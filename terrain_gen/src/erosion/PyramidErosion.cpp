@@ -0,0 +1,167 @@
+#include "PyramidErosion.h"
+
+#include <omp.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <utility>
+#include <vector>
+
+#include "Log.h"
+
+namespace erosion {
+
+// no level smaller than this on its short side, below it channels are a cell or two wide
+static constexpr int kMinLevelSize = 32;
+
+// 2x2 box average, odd edges average what is there
+static GridFloat downsample(const GridFloat &src) {
+	const int W = src.width(), H = src.height();
+	const int w = (W + 1) / 2, h = (H + 1) / 2;
+	GridFloat dst(w, h);
+#pragma omp parallel for schedule(static)
+	for (int y = 0; y < h; y++) {
+		const int y0 = 2 * y, y1 = std::min(2 * y + 1, H - 1);
+		for (int x = 0; x < w; x++) {
+			const int x0 = 2 * x, x1 = std::min(2 * x + 1, W - 1);
+			dst(x, y) = 0.25f * (src(x0, y0) + src(x1, y0) + src(x0, y1) + src(x1, y1));
+		}
+	}
+	return dst;
+}
+
+// dst(x, y) += scale * src bilinearly sampled at the same point of the map (cell centres aligned)
+static void addUpsampled(GridFloat &dst, const GridFloat &src, float scale) {
+	const int W = dst.width(), H = dst.height();
+	const int w = src.width(), h = src.height();
+	const float rx = (float)w / (float)W, ry = (float)h / (float)H;
+#pragma omp parallel for schedule(static)
+	for (int y = 0; y < H; y++) {
+		float fy = std::clamp((y + 0.5f) * ry - 0.5f, 0.0f, (float)(h - 1));
+		int y0 = (int)fy, y1 = std::min(y0 + 1, h - 1);
+		float sy = fy - y0;
+		for (int x = 0; x < W; x++) {
+			float fx = std::clamp((x + 0.5f) * rx - 0.5f, 0.0f, (float)(w - 1));
+			int x0 = (int)fx, x1 = std::min(x0 + 1, w - 1);
+			float sx = fx - x0;
+			float a = src(x0, y0) * (1 - sx) + src(x1, y0) * sx;
+			float b = src(x0, y1) * (1 - sx) + src(x1, y1) * sx;
+			dst(x, y) += scale * (a * (1 - sy) + b * sy);
+		}
+	}
+}
+
+static void scale(GridFloat &g, float s) {
+	float *d = g.data();
+#pragma omp parallel for schedule(static)
+	for (size_t i = 0; i < g.size(); i++) d[i] *= s;
+}
+
+// the coarsest level gets the full-map droplet density, the finer ones a quarter of it to refine
+static float levelShare(const ErosionParams &params, int level, int top) {
+	if (level < (int)params.pyramidDroplets.size()) return std::max(0.0f, params.pyramidDroplets[level]);
+	return (level == top ? 1.0f : 0.25f) / (float)(1 << (2 * level));
+}
+
+ErosionStats runPyramidErosion(GridFloat &heightGrid, const ErosionParams &params, GridFloat *outEroded, GridFloat *outDeposited) {
+	ErosionStats stats;
+	const int W = heightGrid.width();
+	const int H = heightGrid.height();
+	if (W <= 0 || H <= 0) return stats;
+	const auto start = std::chrono::steady_clock::now();
+
+	// level k is about W / 2^k x H / 2^k
+	std::vector<GridFloat> levels;
+	levels.push_back(heightGrid);
+	for (int k = 1; k <= params.pyramidLevels; k++) {
+		const GridFloat &fine = levels.back();
+		if (std::min(fine.width(), fine.height()) / 2 < kMinLevelSize) break;
+		levels.push_back(downsample(fine));
+	}
+	const int top = (int)levels.size() - 1;
+	if (top < params.pyramidLevels) LOG_WARN("[EROSION] pyramid capped at " << top << " levels for a " << W << "x" << H << " map");
+
+	// eroded / deposited / height change so far, carried down the pyramid in the current level's cells
+	GridFloat carryErode, carryDeposit, carryDelta;
+	double coarseNet = 0.0;	 // net height change of the levels above 0, in full-resolution cells
+	for (int k = top; k >= 0; k--) {
+		GridFloat &level = levels[k];
+		const int w = level.width(), h = level.height();
+
+		ErosionParams sub = params;
+		sub.pyramidLevels = 0;
+		sub.numDroplets = (int)std::lround((double)params.numDroplets * levelShare(params, k, top));
+		sub.worldSeed = params.worldSeed + 7919LL * k;	// levels don't replay each other's spawn pattern
+		if (params.timeBudgetMs > 0.0) {
+			// one budget for the whole pyramid, a level gets what the ones above left over
+			double spent = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			sub.timeBudgetMs = std::max(1e-3, params.timeBudgetMs - spent);
+		}
+
+		GridFloat eroded(w, h, 0.0f), deposited(w, h, 0.0f);
+		ErosionStats ls;
+		if (k == 0) {
+			// what reached the full-resolution height has to match the net change of the coarser levels,
+			// up to the ground clamp and the upsampling at the borders. catches a level whose change
+			// isn't carried down
+			double delivered = 0.0;
+			const float *src = heightGrid.data();
+			const float *dst = level.data();
+#pragma omp parallel for schedule(static) reduction(+ : delivered)
+			for (size_t i = 0; i < level.size(); i++) delivered += (double)dst[i] - (double)src[i];
+			LOG_DEBUG("[EROSION] pyramid carried down: net=" << delivered << " coarse levels net=" << coarseNet);
+			if (top > 0 && std::fabs(delivered - coarseNet) > 0.25 * std::fabs(coarseNet) + 1e-3 * (double)level.size())
+				LOG_WARN("[EROSION] pyramid: coarse levels changed the height by " << coarseNet << " but " << delivered << " reached full resolution");
+			if (sub.numDroplets > 0) ls = runHydraulicErosion(level, sub, &eroded, &deposited);
+		} else {
+			// a level-k cell is 2^k cells wide. the droplets run on the height divided by that, so slopes
+			// (and with them speed and capacity) match the full-resolution ones. their change is used
+			// unscaled: a coarse step stands in for 2^k fine droplets side by side over 2^k fine steps,
+			// which moves the same material per fine cell. powers of two scale exactly
+			GridFloat work = level;
+			scale(work, 1.0f / (float)(1 << k));
+			GridFloat before = work;
+			if (sub.numDroplets > 0) ls = runHydraulicErosion(work, sub, &eroded, &deposited);
+
+			// the change this level made plus what the coarser levels passed down to it, onto the finer
+			// level. levels[k - 1] is still the plain downsample of the input, so it needs all of it
+#pragma omp parallel for schedule(static)
+			for (size_t i = 0; i < work.size(); i++) work.data()[i] -= before.data()[i];
+			double own = 0.0;
+#pragma omp parallel for schedule(static) reduction(+ : own)
+			for (size_t i = 0; i < work.size(); i++) own += work.data()[i];
+			coarseNet += own * (double)W * (double)H / ((double)w * (double)h);
+			if (k < top) addUpsampled(work, carryDelta, 1.0f);
+			GridFloat &finer = levels[k - 1];
+			addUpsampled(finer, work, 1.0f);
+#pragma omp parallel for schedule(static)
+			for (size_t i = 0; i < finer.size(); i++) finer.data()[i] = std::max(0.0f, finer.data()[i]);
+			carryDelta = std::move(work);
+		}
+
+		// a level-k cell covers this many full-resolution cells
+		const double area = (double)W * (double)H / ((double)w * (double)h);
+		stats.totalEroded += ls.totalEroded * area;
+		stats.totalDeposited += ls.totalDeposited * area;
+		stats.appliedDroplets += ls.appliedDroplets;
+		stats.epochs += ls.epochs;
+		stats.epochMeanDelta.insert(stats.epochMeanDelta.end(), ls.epochMeanDelta.begin(), ls.epochMeanDelta.end());
+		LOG_INFO("[EROSION] pyramid level " << k << " (" << w << "x" << h << "): droplets=" << ls.appliedDroplets << " eroded=" << ls.totalEroded * area);
+
+		if (k < top) {
+			addUpsampled(eroded, carryErode, 1.0f);
+			addUpsampled(deposited, carryDeposit, 1.0f);
+		}
+		carryErode = std::move(eroded);
+		carryDeposit = std::move(deposited);
+	}
+
+	heightGrid = std::move(levels[0]);
+	if (outEroded) *outEroded = std::move(carryErode);
+	if (outDeposited) *outDeposited = std::move(carryDeposit);
+	stats.elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	return stats;
+}
+
+}  // namespace erosion
@@ -0,0 +1,16 @@
+#pragma once
+
+#include "ErosionParams.h"
+#include "HydraulicErosion.h"
+#include "Types.h"
+
+namespace erosion {
+
+// coarse-to-fine droplet erosion: runHydraulicErosion on a 2x box-downsampled pyramid of the height,
+// coarsest level first, with the height change of all levels so far bilinearly upsampled onto the next,
+// then a full-resolution pass with its own droplet budget. picked by runHydraulicErosion when
+// params.pyramidLevels > 0. totals are in full-resolution cells, epochs / curve are concatenated over
+// the levels, coarsest first
+ErosionStats runPyramidErosion(GridFloat &heightGrid, const ErosionParams &params, GridFloat *outEroded = nullptr, GridFloat *outDeposited = nullptr);
+
+}  // namespace erosion
@@ -0,0 +1,110 @@
+#include "ThermalErosion.h"
+
+#include <omp.h>
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+namespace erosion {
+
+static constexpr int kDx[8] = {-1, 0, 1, -1, 1, -1, 0, 1};
+static constexpr int kDy[8] = {-1, -1, -1, 0, 0, 1, 1, 1};
+
+// what cell (x, y) sheds this iteration (`out`) and the factor turning a neighbour's excess into its
+// share of it. Checked = bounds-test neighbours, only needed on the map border
+template <bool Checked>
+static inline void shedding(const float *h, int W, int H, int x, int y, const float *talus, float rate, float &share, float &out) {
+	const float hc = h[(size_t)y * W + x];
+	float sum = 0.0f, worst = 0.0f;
+	for (int k = 0; k < 8; k++) {
+		int nx = x + kDx[k], ny = y + kDy[k];
+		if (Checked && (nx < 0 || ny < 0 || nx >= W || ny >= H)) continue;
+		float excess = hc - h[(size_t)ny * W + nx] - talus[k];
+		sum += std::max(0.0f, excess);
+		worst = std::max(worst, excess);
+	}
+	// moving half the steepest excess levels that pair, rate < 1 keeps it from overshooting
+	out = rate * 0.5f * worst;
+	share = sum > 0.0f ? out / sum : 0.0f;
+}
+
+// new height of (x, y): its own loss plus what the higher neighbours send its way
+template <bool Checked>
+static inline float settle(const float *h, const float *share, const float *out, int W, int H, int x, int y, const float *talus) {
+	const size_t i = (size_t)y * W + x;
+	const float hc = h[i];
+	float v = hc - out[i];
+	for (int k = 0; k < 8; k++) {
+		int nx = x + kDx[k], ny = y + kDy[k];
+		if (Checked && (nx < 0 || ny < 0 || nx >= W || ny >= H)) continue;
+		size_t n = (size_t)ny * W + nx;
+		// talus is symmetric, the excess of n towards us uses the same limit
+		v += share[n] * std::max(0.0f, h[n] - hc - talus[k]);
+	}
+	return v;
+}
+
+ThermalStats runThermalErosion(GridFloat &heightGrid, const ThermalParams &params) {
+	const int W = heightGrid.width();
+	const int H = heightGrid.height();
+	ThermalStats stats;
+	if (W <= 0 || H <= 0) return stats;
+
+	// largest stable height difference to each neighbour, diagonals are sqrt(2) further away
+	const float slope = std::tan(params.talusAngle * 3.14159265f / 180.0f) * params.cellSize;
+	float talus[8];
+	for (int k = 0; k < 8; k++) talus[k] = slope * ((kDx[k] != 0 && kDy[k] != 0) ? 1.41421356f : 1.0f);
+	const float rate = std::clamp(params.rate, 0.0f, 1.0f);
+
+	GridFloat next(W, H), share(W, H), out(W, H);
+	for (int it = 0; it < params.maxIterations; it++) {
+		const float *h = heightGrid.data();
+		float *sh = share.data();
+		float *ou = out.data();
+#pragma omp parallel for schedule(static)
+		for (int y = 0; y < H; y++) {
+			if (y == 0 || y == H - 1 || W < 3) {
+				for (int x = 0; x < W; x++) shedding<true>(h, W, H, x, y, talus, rate, sh[(size_t)y * W + x], ou[(size_t)y * W + x]);
+				continue;
+			}
+			shedding<true>(h, W, H, 0, y, talus, rate, sh[(size_t)y * W], ou[(size_t)y * W]);
+#pragma omp simd
+			for (int x = 1; x < W - 1; x++) shedding<false>(h, W, H, x, y, talus, rate, sh[(size_t)y * W + x], ou[(size_t)y * W + x]);
+			shedding<true>(h, W, H, W - 1, y, talus, rate, sh[(size_t)y * W + W - 1], ou[(size_t)y * W + W - 1]);
+		}
+
+		float residual = 0.0f;
+		double moved = 0.0;
+		float *dst = next.data();
+#pragma omp parallel for schedule(static) reduction(max : residual) reduction(+ : moved)
+		for (int y = 0; y < H; y++) {
+			float rowResidual = 0.0f;
+			double rowMoved = 0.0;
+			if (y == 0 || y == H - 1 || W < 3) {
+				for (int x = 0; x < W; x++) dst[(size_t)y * W + x] = settle<true>(h, sh, ou, W, H, x, y, talus);
+			} else {
+				dst[(size_t)y * W] = settle<true>(h, sh, ou, W, H, 0, y, talus);
+#pragma omp simd
+				for (int x = 1; x < W - 1; x++) dst[(size_t)y * W + x] = settle<false>(h, sh, ou, W, H, x, y, talus);
+				dst[(size_t)y * W + W - 1] = settle<true>(h, sh, ou, W, H, W - 1, y, talus);
+			}
+			for (int x = 0; x < W; x++) {
+				size_t i = (size_t)y * W + x;
+				rowResidual = std::max(rowResidual, std::fabs(dst[i] - h[i]));
+				rowMoved += ou[i];
+			}
+			residual = std::max(residual, rowResidual);
+			moved += rowMoved;
+		}
+		std::swap(heightGrid, next);
+
+		stats.iterations = it + 1;
+		stats.residual = residual;
+		stats.moved += moved;
+		if (residual < params.tolerance) break;
+	}
+	return stats;
+}
+
+}  // namespace erosion
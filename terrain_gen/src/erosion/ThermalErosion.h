@@ -0,0 +1,25 @@
+#pragma once
+
+#include "Types.h"
+
+namespace erosion {
+
+struct ThermalParams {
+	float talusAngle = 40.0f;		   // degrees, anything steeper slumps
+	float cellSize = 1.0f / 256.0f;	   // horizontal spacing of a cell in height units (heights are ~0..1)
+	float rate = 0.5f;				   // share of a cell's excess over the talus it sheds per iteration
+	int maxIterations = 50;
+	float tolerance = 1e-5f;  // stop once no cell moved more than this in an iteration
+};
+
+struct ThermalStats {
+	int iterations = 0;
+	float residual = 0.0f;	// largest height change of the last iteration
+	double moved = 0.0;		// total material shed downhill over all iterations
+};
+
+// talus relaxation: material above the talus slope towards any of the 8 neighbours slides down to them,
+// split by how far each neighbour is over the limit. double-buffered stencil sweeps, mass conserving
+ThermalStats runThermalErosion(GridFloat &heightGrid, const ThermalParams &params);
+
+}  // namespace erosion
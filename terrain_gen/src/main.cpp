@@ -4,6 +4,7 @@
 #include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <sstream>
 #include <string>
 #include <unordered_map>
 #include <vector>
@@ -13,8 +14,12 @@
 #include "BiomeSystem.h"
 #include "ErosionParams.h"
 #include "HydraulicErosion.h"
+#include "Log.h"
+#include "NoiseGraph.h"
+#include "NoiseSimd.h"
 #include "PerlinNoise.h"
 #include "RiverGenerator.h"
+#include "ThermalErosion.h"
 #include "Types.h"
 #include "WorldType_Voronoi.h"
 #include "json.hpp"
@@ -36,12 +41,18 @@ int main() {
 	try {
 		f >> cfg;
 	} catch (const std::exception& e) {
-		std::cerr << "[EXCEPTION] Failed parse config.json: " << e.what() << std::endl;
+		LOG_ERROR("[EXCEPTION] Failed parse config.json: " << e.what());
 		return 1;
 	}
 	f.close();
 
-	for (auto it = cfg.begin(); it != cfg.end(); it++) std::cerr << it.key() << " ";
+	if (cfg.contains("logLevel")) logging::setLevel(logging::parseLevel(cfg["logLevel"].get<std::string>().c_str(), logging::level()));
+	if (logging::enabled(logging::Level::Debug)) {
+		std::string keys;
+		for (auto it = cfg.begin(); it != cfg.end(); it++) keys += it.key() + " ";
+		LOG_DEBUG("[CONFIG] " << keys);
+	}
+	LOG_INFO("[NOISE] simd kernels: " << noise_simd::isaName(noise_simd::kernels().isa));
 
 	int W = cfg.value("width", 512);
 	int H = cfg.value("height", 512);
@@ -52,6 +63,11 @@ int main() {
 	// -----------------------------
 
 	Grid2D<float> height(W, H), temp(W, H), moist(W, H);
+	// analytic dh/dx, dh/dy from generation, only valid until erosion changes the height
+	Grid2D<float> gradX, gradY;
+	bool analyticSlope = cfg.value("analyticSlope", true);
+	// "permutation" (classic 256 table) or "hash" (table-free, non-repeating)
+	NoiseBackend noiseBackend = cfg.value("noiseBackend", std::string("permutation")) == "hash" ? NoiseBackend::Hash : NoiseBackend::Permutation;
 	Grid2D<uint8_t> rivers(W, H);
 	Grid2D<Biome> biomeMap(W, H);
 
@@ -63,45 +79,90 @@ int main() {
 		vcfg.fbmFrequency = cfg.value("fbmFrequency", 0.0035f);
 		vcfg.fbmOctaves = cfg.value("fbmOctaves", 5);
 
+		vcfg.fbmBandLimit = cfg.value("fbmBandLimit", true);
+		vcfg.noiseBackend = noiseBackend;
+		vcfg.warpStrength = cfg.value("warpStrength", 0.0f);
+		vcfg.warpFrequency = cfg.value("warpFrequency", vcfg.warpFrequency);
+		vcfg.warpOctaves = cfg.value("warpOctaves", vcfg.warpOctaves);
+		vcfg.plateRaster = cfg.value("plateRaster", false);
+
 		WorldType_Voronoi world(W, H, vcfg);
-		world.generate(height);
+
+		// -----------------------------
+		// height, temperature and moisture in one fused tiled pass
+		// -----------------------------
+		using noise_graph::Inputs;
+		using noise_graph::Span;
+		noise_graph::NoiseGraph graph;
+		int heightNode = graph.addNode("height", analyticSlope ? 3 : 1, [&](const Span& s, const Inputs&, float* const* out) {
+			world.generateRow(s.y, s.x0, s.count, out[0], analyticSlope ? out[1] : nullptr, analyticSlope ? out[2] : nullptr);
+		});
+		graph.bind(heightNode, &height);
+		if (analyticSlope) {
+			graph.bind(heightNode, &gradX, 1);
+			graph.bind(heightNode, &gradY, 2);
+		}
+
+		float baseFreq = 0.0025f;
+		const FbmTable climateTable(4, 2.0f, 0.6f);
+		PerlinNoise pTemp(seed ^ 0xA5A5A5), pMoist(seed ^ 0x5A5A5A);
+		HashedPerlinNoise hTemp(seed ^ 0xA5A5A5), hMoist(seed ^ 0x5A5A5A);
+		// > 0: climate fbm on a coarse grid + bicubic upsampling, within this max abs error (fbm units, -1..1)
+		float climateMaxError = cfg.value("climateMaxError", 0.0f);
+		auto climateNoise = [&](const char* name, const auto& noise, float freq, float offset) {
+			if (climateMaxError > 0.0f) return graph.addUpsampledFbm(name, noise, climateTable, freq, climateMaxError, offset, offset);
+			return graph.addFbm<4>(name, noise, climateTable, freq, offset, offset);
+		};
+		int tempNoise, moistNoise;
+		if (noiseBackend == NoiseBackend::Hash) {
+			tempNoise = climateNoise("tempNoise", hTemp, baseFreq * 1.2f, 100.0f);
+			moistNoise = climateNoise("moistNoise", hMoist, baseFreq * 1.5f, -100.0f);
+		} else {
+			tempNoise = climateNoise("tempNoise", pTemp, baseFreq * 1.2f, 100.0f);
+			moistNoise = climateNoise("moistNoise", pMoist, baseFreq * 1.5f, -100.0f);
+		}
+		int tempNode = graph.addNode("temperature", [&](const Span& s, const Inputs& in, float* const* out) {
+			const float* n = in.row(tempNoise);
+			float latFactor = 1.0f - fabsf(((float)s.y / (float)H) * 2.0f - 1.0f);
+			for (int i = 0; i < s.count; i++) {
+				float t = (n[i] + 1.0f) * 0.5f;
+				t = t * 0.6f + 0.4f * latFactor;
+				out[0][i] = std::clamp(t, 0.0f, 1.0f);
+			}
+		});
+		int moistNode = graph.addNode("moisture", [&](const Span& s, const Inputs& in, float* const* out) {
+			const float* n = in.row(moistNoise);
+			const float* e = in.row(heightNode);
+			for (int i = 0; i < s.count; i++) {
+				float m = (n[i] + 1.0f) * 0.5f;
+				m = m * (0.6f + (1.0f - e[i]) * 0.4f);
+				out[0][i] = std::clamp(m, 0.0f, 1.0f);
+			}
+		});
+		graph.bind(tempNode, &temp);
+		graph.bind(moistNode, &moist);
+		graph.evaluate(W, H);
+
+		float previewSpacing = cfg.value("previewSpacing", 0.0f);
+		if (previewSpacing > 1.0f) {
+			Grid2D<float> preview;
+			world.generateLod(preview, previewSpacing);
+			std::filesystem::create_directories("out");
+			auto pRGB = helper::heightToRGB(preview);
+			if (!helper::writePPM("out/height_preview.ppm", preview.width(), preview.height(), pRGB)) LOG_ERROR("Failed write out/height_preview.ppm");
+		}
 
 	} catch (const std::exception& e) {
-		std::cerr << "[EXCEPTION] during grid/world construction: " << e.what() << std::endl;
+		LOG_ERROR("[EXCEPTION] during grid/world construction: " << e.what());
 		return 1;
 	} catch (...) {
-		std::cerr << "[EXCEPTION] unknown error during grid/world construction" << std::endl;
+		LOG_ERROR("[EXCEPTION] unknown error during grid/world construction");
 		return 1;
 	}
 
 	std::filesystem::create_directories("out");
 	auto hRGB_before = helper::heightToRGB(height);
-	if (!helper::writePPM("out/height_before_erosion.ppm", W, H, hRGB_before)) std::cerr << "Failed write out/height_before_erosion.ppm\n";
-
-	// -----------------------------
-	// Generate temperature and moisture maps
-	// -----------------------------
-	PerlinNoise pTemp(seed ^ 0xA5A5A5);
-	PerlinNoise pMoist(seed ^ 0x5A5A5A);
-	float baseFreq = 0.0025f;
-
-#pragma omp parallel for collapse(2) schedule(static)
-	for (int y = 0; y < H; y++)
-		for (int x = 0; x < W; x++) {
-			float e = height(x, y);
-			float fx = (float)x;
-			float fy = (float)y;
-			float t = pTemp.fbm(fx + 100.0f, fy + 100.0f, baseFreq * 1.2f, 4, 2.0f, 0.6f);
-			t = (t + 1.0f) * 0.5f;
-			float latFactor = 1.0f - fabsf(((float)y / (float)H) * 2.0f - 1.0f);
-			t = t * 0.6f + 0.4f * latFactor;
-			temp(x, y) = std::clamp(t, 0.0f, 1.0f);
-
-			float m = pMoist.fbm(fx - 100.0f, fy - 100.0f, baseFreq * 1.5f, 4, 2.0f, 0.6f);
-			m = (m + 1.0f) * 0.5f;
-			m = m * (0.6f + (1.0f - e) * 0.4f);
-			moist(x, y) = std::clamp(m, 0.0f, 1.0f);
-		}
+	if (!helper::writePPM("out/height_before_erosion.ppm", W, H, hRGB_before)) LOG_ERROR("Failed write out/height_before_erosion.ppm");
 
 	std::vector<BiomeDef> defs;
 	std::ifstream bf("biomes.json");
@@ -121,13 +182,14 @@ int main() {
 	opts.lakeHeightThreshold = cfg.value("lakeHeightThreshold", 0.45f);
 	opts.smoothingIterations = cfg.value("smoothingIterations", 1);
 
-	bool ok_pre = biome::classifyBiomeMap(height, temp, moist, nullptr, defs, biomeMap, opts);
+	bool ok_pre = analyticSlope ? biome::classifyBiomeMap(height, temp, moist, nullptr, defs, biomeMap, opts, &gradX, &gradY)
+								: biome::classifyBiomeMap(height, temp, moist, nullptr, defs, biomeMap, opts);
 	if (!ok_pre) {
-		std::cerr << "Classification failed (dimension mismatch)\n";
+		LOG_ERROR("Classification failed (dimension mismatch)");
 		return 1;
 	}
 	auto bRGB_pre = helper::biomeToRGB(biomeMap);
-	if (!helper::writePPM("out/biome_before_erosion.ppm", W, H, bRGB_pre)) std::cerr << "Failed write out/biome_before_erosion.ppm\n";
+	if (!helper::writePPM("out/biome_before_erosion.ppm", W, H, bRGB_pre)) LOG_ERROR("Failed write out/biome_before_erosion.ppm");
 
 	// -----------------------------
 	// Run hydraulic erosion stage
@@ -141,29 +203,57 @@ int main() {
 	eparams.erodeRate = 0.5f;
 	eparams.depositRate = 0.3f;
 	eparams.evaporateRate = 0.015f;
+	eparams.epochs = cfg.value("erosionEpochs", 1);
+	eparams.timeBudgetMs = cfg.value("erosionTimeBudgetMs", 0.0);
+	eparams.convergeEpsilon = cfg.value("erosionConvergeEpsilon", 0.0f);
+	eparams.pyramidLevels = cfg.value("erosionPyramidLevels", 0);
+	eparams.pyramidDroplets = cfg.value("erosionPyramidDroplets", std::vector<float>());
+	eparams.usePerThreadBuffers = cfg.value("erosionEngine", std::string("perThread")) != "tiled";
+	eparams.tileSize = cfg.value("erosionTileSize", eparams.tileSize);
+	eparams.dropletLanes = cfg.value("erosionLanes", 0);
+	eparams.erosionRadius = cfg.value("erosionRadius", eparams.erosionRadius);
+	eparams.packedGradient = cfg.value("erosionPackedGradient", false);
+	std::string dropletOrder = cfg.value("erosionOrder", std::string("index"));
+	if (dropletOrder == "morton") eparams.dropletOrder = DropletOrder::Morton;
+	if (dropletOrder == "hilbert") eparams.dropletOrder = DropletOrder::Hilbert;
+	if (cfg.value("erosionModel", std::string("droplets")) == "pipe") eparams.model = ErosionModel::Pipe;
+	eparams.pipeIterations = cfg.value("pipeIterations", eparams.pipeIterations);
 	Grid2D<float> erodeMap(W, H), depositMap(W, H);
 	auto stats = erosion::runHydraulicErosion(height, eparams, &erodeMap, &depositMap);
 
 	std::cout << "[EROSION] totalEroded=" << stats.totalEroded << " totalDeposited=" << stats.totalDeposited << " droplets=" << stats.appliedDroplets
 			  << std::endl;
+	if (eparams.epochs > 1) {
+		std::ostringstream curve;
+		for (double d : stats.epochMeanDelta) curve << ' ' << d;
+		LOG_INFO("[EROSION] " << stats.epochs << " epochs in " << stats.elapsedMs << " ms, mean |delta| per epoch:" << curve.str());
+	}
 
-	std::cerr << "[DEBUG] Hydraulic erosion finished" << std::endl;
-	std::cerr << "[EROSION] totalEroded=" << stats.totalEroded << " totalDeposited=" << stats.totalDeposited << " droplets=" << stats.appliedDroplets
-			  << std::endl;
+	LOG_DEBUG("Hydraulic erosion finished");
+
+	// talus slumping on what the water left, off unless thermalIterations > 0
+	erosion::ThermalParams tparams;
+	tparams.maxIterations = cfg.value("thermalIterations", 0);
+	tparams.talusAngle = cfg.value("talusAngle", tparams.talusAngle);
+	tparams.cellSize = cfg.value("thermalCellSize", 1.0f / (float)std::max(W, H));
+	if (tparams.maxIterations > 0) {
+		auto tstats = erosion::runThermalErosion(height, tparams);
+		std::cout << "[THERMAL] iterations=" << tstats.iterations << " residual=" << tstats.residual << " moved=" << tstats.moved << std::endl;
+	}
 
 	auto erodedRGB = helper::heightToRGB(erodeMap);
 	auto depositRGB = helper::heightToRGB(depositMap);
 	auto hRGB_after = helper::heightToRGB(height);
-	if (!helper::writePPM("out/erosion_eroded.ppm", W, H, erodedRGB)) std::cerr << "Failed write out/erosion_eroded.ppm\n";
-	if (!helper::writePPM("out/erosion_deposited.ppm", W, H, depositRGB)) std::cerr << "Failed write out/erosion_deposited.ppm\n";
-	if (!helper::writePPM("out/height_after_erosion.ppm", W, H, hRGB_after)) std::cerr << "Failed write out/height_after_erosion.ppm\n";
+	if (!helper::writePPM("out/erosion_eroded.ppm", W, H, erodedRGB)) LOG_ERROR("Failed write out/erosion_eroded.ppm");
+	if (!helper::writePPM("out/erosion_deposited.ppm", W, H, depositRGB)) LOG_ERROR("Failed write out/erosion_deposited.ppm");
+	if (!helper::writePPM("out/height_after_erosion.ppm", W, H, hRGB_after)) LOG_ERROR("Failed write out/height_after_erosion.ppm");
 
 	bool ok_after_erosion = biome::classifyBiomeMap(height, temp, moist, nullptr, defs, biomeMap, opts);
 	if (!ok_after_erosion) {
-		std::cerr << "[ERROR] Classification failed after erosion (dimension mismatch)\n";
+		LOG_ERROR("Classification failed after erosion (dimension mismatch)");
 	} else {
 		auto bRGB_after_erosion = helper::biomeToRGB(biomeMap);
-		if (!helper::writePPM("out/biome_after_erosion.ppm", W, H, bRGB_after_erosion)) std::cerr << "Failed write out/biome_after_erosion.ppm\n";
+		if (!helper::writePPM("out/biome_after_erosion.ppm", W, H, bRGB_after_erosion)) LOG_ERROR("Failed write out/biome_after_erosion.ppm");
 	}
 
 	// -----------------------------
@@ -188,19 +278,19 @@ int main() {
 	const std::vector<float>& heightAfterRiversVec = rg.getHeightmap();
 
 	auto riverMaskRGB = helper::maskToRGB(riverMask, W, H);
-	if (!helper::writePPM("out/river_map.ppm", W, H, riverMaskRGB)) std::cerr << "Failed to write out/river_map.ppm\n";
+	if (!helper::writePPM("out/river_map.ppm", W, H, riverMaskRGB)) LOG_ERROR("Failed to write out/river_map.ppm");
 
 	helper::vectorToGrid(heightAfterRiversVec, height);
 
 	auto hRGB_after_rivers = helper::heightToRGB(height);
-	if (!helper::writePPM("out/height_after_rivers.ppm", W, H, hRGB_after_rivers)) std::cerr << "Failed to write out/height_after_rivers.ppm\n";
+	if (!helper::writePPM("out/height_after_rivers.ppm", W, H, hRGB_after_rivers)) LOG_ERROR("Failed to write out/height_after_rivers.ppm");
 
 	bool ok_after_rivers = biome::classifyBiomeMap(height, temp, moist, nullptr, defs, biomeMap, opts);
 	if (!ok_after_rivers) {
-		std::cerr << "[ERROR] Classification failed after rivers (dimension mismatch)\n";
+		LOG_ERROR("Classification failed after rivers (dimension mismatch)");
 	} else {
 		auto bRGB_after_rivers = helper::biomeToRGB(biomeMap);
-		if (!helper::writePPM("out/biome_after_rivers.ppm", W, H, bRGB_after_rivers)) std::cerr << "Failed write out/biome_after_rivers.ppm\n";
+		if (!helper::writePPM("out/biome_after_rivers.ppm", W, H, bRGB_after_rivers)) LOG_ERROR("Failed write out/biome_after_rivers.ppm");
 	}
 
 	// -----------------------------
@@ -208,11 +298,12 @@ int main() {
 	// -----------------------------
 	auto hRGB = helper::heightToRGB(height);
 	auto bRGB = helper::biomeToRGB(biomeMap);
-	if (!helper::writePPM("out/height.ppm", W, H, hRGB)) std::cerr << "Failed write height\n";
-	if (!helper::writePPM("out/biome.ppm", W, H, bRGB)) std::cerr << "Failed write biome\n";
+	if (!helper::writePPM("out/height.ppm", W, H, hRGB)) LOG_ERROR("Failed write height");
+	if (!helper::writePPM("out/biome.ppm", W, H, bRGB)) LOG_ERROR("Failed write biome");
 
 	float end_time = static_cast<float>(std::clock()) / CLOCKS_PER_SEC;
 	std::cout << "Total time: " << (end_time - start_time) << " seconds\n";
+	logging::flush();
 
 	return 0;
 }
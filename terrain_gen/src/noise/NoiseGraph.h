@@ -0,0 +1,257 @@
+#pragma once
+#include <omp.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "PerlinNoise.h"
+#include "Types.h"
+
+// fused multi-field evaluator. a stage declares its fields (height, climate, warps, ...) as nodes,
+// evaluate() then walks the map tile by tile and runs every node on each tile row while it is still
+// in cache, writing all bound outputs in the same pass instead of one full-grid sweep per field.
+//
+// nodes run in declaration order, so a node can read the rows of any node declared before it
+// (e.g. moisture reading height, or a base fbm reading its warp offsets). unbound nodes are scratch.
+namespace noise_graph {
+
+// the run of samples a node fills: row y, columns x0 .. x0 + count - 1
+struct Span {
+	int y;
+	int x0;
+	int count;
+};
+
+class NoiseGraph;
+
+// read access to the already evaluated nodes of the current span
+class Inputs {
+   public:
+	const float* row(int node, int channel = 0) const;
+
+   private:
+	friend class NoiseGraph;
+	const NoiseGraph* graph_ = nullptr;
+	const float* scratch_ = nullptr;
+	int current_ = 0;
+};
+
+// out[c] points at channel c of this node for the span (count floats each)
+using RowFn = std::function<void(const Span& s, const Inputs& in, float* const* out)>;
+// optional per-node setup, run once per evaluate() before the tiled pass (width, height of the map)
+using PrepareFn = std::function<void(int width, int height)>;
+
+inline float catmullRom(float p0, float p1, float p2, float p3, float t) {
+	return 0.5f * (2.0f * p1 + (p2 - p0) * t + (2.0f * p0 - 5.0f * p1 + 4.0f * p2 - p3) * t * t + (3.0f * (p1 - p2) + p3 - p0) * t * t * t);
+}
+
+// worst-case catmull-rom error on a unit sine sampled every `w` radians, over phases and positions
+inline float catmullRomSineError(float w) {
+	float worst = 0.0f;
+	for (int ph = 0; ph < 16; ph++) {
+		float phi = (float)ph * 0.3926991f;	 // 2pi / 16
+		float p0 = std::sin(phi - w), p1 = std::sin(phi), p2 = std::sin(phi + w), p3 = std::sin(phi + 2.0f * w);
+		for (int k = 1; k < 16; k++) {
+			float t = (float)k / 16.0f;
+			worst = std::max(worst, std::fabs(catmullRom(p0, p1, p2, p3, t) - std::sin(phi + t * w)));
+		}
+	}
+	return worst;
+}
+
+// largest coarse step (in samples, 1 = full res) whose bicubic reconstruction of this fbm stays
+// within maxError. each octave is treated as a sine weighted by its share of the normalised amplitude,
+// doubled for the two axes. perlin energy sits below the lattice frequency, kSpectralFreq = 0.7 of it
+// keeps the measured max error at ~0.6x the bound
+inline int coarseStep(const FbmTable& t, float baseFreq, float maxError, int maxStep = 64) {
+	constexpr float kSpectralFreq = 0.7f;
+	if (maxError <= 0.0f || t.maxAmp <= 0.0f) return 1;
+	int best = 1;
+	for (int h = 2; h <= maxStep; h++) {
+		float err = 0.0f;
+		for (int i = 0; i < t.octaves; i++) {
+			float w = kSpectralFreq * 6.2831853f * baseFreq * t.freq[i] * (float)h;
+			err += (w >= 3.1415927f ? 2.0f : catmullRomSineError(w)) * t.amp[i] / t.maxAmp;
+		}
+		if (2.0f * err > maxError) break;
+		best = h;
+	}
+	return best;
+}
+
+class NoiseGraph {
+   public:
+	int tileSize = 64;	// tile edge in samples, rows of a tile are evaluated back to back
+
+	int addNode(std::string name, int channels, RowFn fn, PrepareFn prepare = nullptr) {
+		assert(channels >= 1);
+		Node n;
+		n.name = std::move(name);
+		n.channels = channels;
+		n.fn = std::move(fn);
+		n.prepare = std::move(prepare);
+		n.outputs.assign(channels, nullptr);
+		n.offset = scratchChannels_;
+		scratchChannels_ += channels;
+		nodes_.push_back(std::move(n));
+		return (int)nodes_.size() - 1;
+	}
+	int addNode(std::string name, RowFn fn) { return addNode(std::move(name), 1, std::move(fn)); }
+
+	// plain fbm field, sample (x, y) reads noise at (x + offsetX, y + offsetY)
+	template <int Octaves, class Noise>
+	int addFbm(std::string name, const Noise& noise, const FbmTable& table, float baseFreq, float offsetX = 0.0f, float offsetY = 0.0f) {
+		return addNode(std::move(name), [&noise, table, baseFreq, offsetX, offsetY](const Span& s, const Inputs&, float* const* out) {
+			noise.template fbmRow<Octaves>((float)s.y + offsetY, (float)s.x0 + offsetX, s.count, out[0], baseFreq, table);
+		});
+	}
+
+	// low-frequency fbm evaluated on a coarse, globally aligned grid (every `step` samples, picked by
+	// coarseStep() from maxError) and reconstructed per sample with bicubic catmull-rom. for smooth
+	// climate fields that is a few percent of the full-res cost
+	template <class Noise>
+	int addUpsampledFbm(std::string name, const Noise& noise, const FbmTable& table, float baseFreq, float maxError, float offsetX = 0.0f,
+						float offsetY = 0.0f) {
+		const int step = coarseStep(table, baseFreq, maxError);
+		if (step <= 1)
+			return addNode(std::move(name), [&noise, table, baseFreq, offsetX, offsetY](const Span& s, const Inputs&, float* const* out) {
+				noise.fbmRow((float)s.y + offsetY, (float)s.x0 + offsetX, s.count, out[0], baseFreq, table);
+			});
+
+		// coarse sample (i, j) sits at ((i - 1) * step, (j - 1) * step): one sample of margin before, two after
+		struct Coarse {
+			int w = 0, h = 0;
+			std::vector<float> v;
+		};
+		auto coarse = std::make_shared<Coarse>();
+		PrepareFn prepare = [&noise, table, baseFreq, offsetX, offsetY, step, coarse](int width, int height) {
+			coarse->w = (width - 1) / step + 4;
+			coarse->h = (height - 1) / step + 4;
+			coarse->v.resize((size_t)coarse->w * coarse->h);
+#pragma omp parallel for schedule(static)
+			for (int j = 0; j < coarse->h; j++) {
+				float y = (float)((j - 1) * step) + offsetY;
+				noise.fbmRow(y, (float)(-step) + offsetX, coarse->w, coarse->v.data() + (size_t)j * coarse->w, baseFreq, table, (float)step);
+			}
+		};
+		RowFn fn = [step, coarse](const Span& s, const Inputs&, float* const* out) {
+			const int cw = coarse->w;
+			const float inv = 1.0f / (float)step;
+			int j = s.y / step;
+			float ty = (float)(s.y - j * step) * inv;
+			const float* r0 = coarse->v.data() + (size_t)j * cw;  // row j - 1 of the sample grid
+			const float* r1 = r0 + cw;
+			const float* r2 = r1 + cw;
+			const float* r3 = r2 + cw;
+			int kx = s.x0 / step;
+			int sub = s.x0 - kx * step;
+			float c0 = catmullRom(r0[kx], r1[kx], r2[kx], r3[kx], ty);
+			float c1 = catmullRom(r0[kx + 1], r1[kx + 1], r2[kx + 1], r3[kx + 1], ty);
+			float c2 = catmullRom(r0[kx + 2], r1[kx + 2], r2[kx + 2], r3[kx + 2], ty);
+			float c3 = catmullRom(r0[kx + 3], r1[kx + 3], r2[kx + 3], r3[kx + 3], ty);
+			for (int i = 0; i < s.count;) {
+				// cubic of the current coarse cell in horner form, then all its samples in this span
+				float a1 = 0.5f * (c2 - c0);
+				float a2 = 0.5f * (2.0f * c0 - 5.0f * c1 + 4.0f * c2 - c3);
+				float a3 = 0.5f * (3.0f * (c1 - c2) + c3 - c0);
+				int n = std::min(step - sub, s.count - i);
+				for (int q = 0; q < n; q++) {
+					float t = (float)(sub + q) * inv;
+					out[0][i + q] = std::clamp(c1 + t * (a1 + t * (a2 + t * a3)), -1.0f, 1.0f);
+				}
+				i += n;
+				sub = 0;
+				if (i < s.count) {
+					// slide the 4-column window one coarse cell right, vertical interpolation once per cell
+					kx++;
+					c0 = c1;
+					c1 = c2;
+					c2 = c3;
+					c3 = catmullRom(r0[kx + 3], r1[kx + 3], r2[kx + 3], r3[kx + 3], ty);
+				}
+			}
+		};
+		return addNode(std::move(name), 1, std::move(fn), std::move(prepare));
+	}
+
+	// write channel `channel` of `node` to `out` (resized to the evaluated size if needed)
+	void bind(int node, GridFloat* out, int channel = 0) {
+		assert(node >= 0 && node < (int)nodes_.size() && channel < nodes_[node].channels);
+		nodes_[node].outputs[channel] = out;
+	}
+
+	int find(const std::string& name) const {
+		for (size_t i = 0; i < nodes_.size(); i++)
+			if (nodes_[i].name == name) return (int)i;
+		return -1;
+	}
+	int nodeCount() const { return (int)nodes_.size(); }
+
+	void evaluate(int width, int height) const {
+		for (const auto& n : nodes_)
+			for (GridFloat* g : n.outputs)
+				if (g && (g->width() != width || g->height() != height)) g->resize(width, height);
+		for (const auto& n : nodes_)
+			if (n.prepare) n.prepare(width, height);
+
+		const int ts = std::max(1, tileSize);
+		const int tilesX = (width + ts - 1) / ts;
+		const int tilesY = (height + ts - 1) / ts;
+#pragma omp parallel
+		{
+			std::vector<float> scratch((size_t)scratchChannels_ * ts);
+			std::vector<float*> outPtrs;
+			Inputs in;
+			in.graph_ = this;
+			in.scratch_ = scratch.data();
+#pragma omp for schedule(dynamic, 1)
+			for (int t = 0; t < tilesX * tilesY; t++) {
+				int tx0 = (t % tilesX) * ts;
+				int ty0 = (t / tilesX) * ts;
+				int tw = std::min(ts, width - tx0);
+				int th = std::min(ts, height - ty0);
+				for (int y = ty0; y < ty0 + th; y++) {
+					Span s{y, tx0, tw};
+					for (size_t ni = 0; ni < nodes_.size(); ni++) {
+						const Node& n = nodes_[ni];
+						outPtrs.resize(n.channels);
+						for (int c = 0; c < n.channels; c++) outPtrs[c] = scratch.data() + (size_t)(n.offset + c) * ts;
+						in.current_ = (int)ni;
+						n.fn(s, in, outPtrs.data());
+						for (int c = 0; c < n.channels; c++)
+							if (GridFloat* g = n.outputs[c]) std::copy(outPtrs[c], outPtrs[c] + tw, g->data() + g->index(tx0, y));
+					}
+				}
+			}
+		}
+	}
+
+   private:
+	friend class Inputs;
+	struct Node {
+		std::string name;
+		int channels = 1;
+		int offset = 0;	 // first scratch channel
+		RowFn fn;
+		PrepareFn prepare;
+		std::vector<GridFloat*> outputs;
+	};
+	std::vector<Node> nodes_;
+	int scratchChannels_ = 0;
+	int stride() const { return std::max(1, tileSize); }
+};
+
+inline const float* Inputs::row(int node, int channel) const {
+	assert(node >= 0 && node < current_ && "nodes can only read nodes declared before them");
+	const auto& n = graph_->nodes_[node];
+	assert(channel >= 0 && channel < n.channels);
+	return scratch_ + (size_t)(n.offset + channel) * graph_->stride();
+}
+
+}  // namespace noise_graph
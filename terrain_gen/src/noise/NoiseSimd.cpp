@@ -0,0 +1,334 @@
+#include "NoiseSimd.h"
+
+#include <cstdlib>
+#include <cstring>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define NOISE_SIMD_X86 1
+#include <immintrin.h>
+#else
+#define NOISE_SIMD_X86 0
+#endif
+
+namespace noise_simd {
+
+#if NOISE_SIMD_X86
+
+// each isa block is compiled with its own target attribute so the binary stays portable;
+// only the block matching the host is ever called. all helpers mirror the scalar
+// fade/lerp/grad expressions term by term (no fma, no reassociation) to stay bit-exact.
+
+#define NOISE_SSE42 __attribute__((target("sse4.2")))
+#define NOISE_AVX2 __attribute__((target("avx2")))
+#define NOISE_AVX512 __attribute__((target("avx512f")))
+
+// ---------------- SSE4.2 (4 lanes, no gather) ----------------
+namespace sse42 {
+
+NOISE_SSE42 static inline __m128 fade(__m128 t) {
+	__m128 t3 = _mm_mul_ps(_mm_mul_ps(t, t), t);
+	__m128 in = _mm_add_ps(_mm_mul_ps(t, _mm_sub_ps(_mm_mul_ps(t, _mm_set1_ps(6.0f)), _mm_set1_ps(15.0f))), _mm_set1_ps(10.0f));
+	return _mm_mul_ps(t3, in);
+}
+
+NOISE_SSE42 static inline __m128 lerp(__m128 a, __m128 b, __m128 t) { return _mm_add_ps(a, _mm_mul_ps(t, _mm_sub_ps(b, a))); }
+
+NOISE_SSE42 static inline __m128 grad(__m128i hash, __m128 x, __m128 y) {
+	__m128i h = _mm_and_si128(hash, _mm_set1_epi32(7));
+	__m128 swap = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(h, _mm_set1_epi32(4)), _mm_set1_epi32(4)));
+	__m128 u = _mm_blendv_ps(x, y, swap);
+	__m128 v = _mm_blendv_ps(y, x, swap);
+	__m128 su = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(h, _mm_set1_epi32(1)), 31));
+	__m128 sv = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(h, _mm_set1_epi32(2)), 30));
+	return _mm_add_ps(_mm_xor_ps(u, su), _mm_xor_ps(v, sv));
+}
+
+NOISE_SSE42 static inline __m128i lookup(const int* perm, __m128i idx) {
+	alignas(16) int i[4];
+	_mm_store_si128((__m128i*)i, idx);
+	return _mm_setr_epi32(perm[i[0]], perm[i[1]], perm[i[2]], perm[i[3]]);
+}
+
+NOISE_SSE42 static inline __m128 noise(const int* perm, int mask, __m128 x, __m128 y) {
+	__m128 fx = _mm_floor_ps(x);
+	__m128 fy = _mm_floor_ps(y);
+	__m128i xi = _mm_and_si128(_mm_cvttps_epi32(fx), _mm_set1_epi32(mask));
+	__m128i yi = _mm_and_si128(_mm_cvttps_epi32(fy), _mm_set1_epi32(mask));
+	__m128 xf = _mm_sub_ps(x, fx);
+	__m128 yf = _mm_sub_ps(y, fy);
+	__m128 u = fade(xf);
+	__m128 v = fade(yf);
+	__m128i one = _mm_set1_epi32(1);
+	__m128i pa = _mm_add_epi32(lookup(perm, xi), yi);
+	__m128i pb = _mm_add_epi32(lookup(perm, _mm_add_epi32(xi, one)), yi);
+	__m128i aa = lookup(perm, pa);
+	__m128i ab = lookup(perm, _mm_add_epi32(pa, one));
+	__m128i ba = lookup(perm, pb);
+	__m128i bb = lookup(perm, _mm_add_epi32(pb, one));
+	__m128 xf1 = _mm_sub_ps(xf, _mm_set1_ps(1.0f));
+	__m128 yf1 = _mm_sub_ps(yf, _mm_set1_ps(1.0f));
+	__m128 x1 = lerp(grad(aa, xf, yf), grad(ba, xf1, yf), u);
+	__m128 x2 = lerp(grad(ab, xf, yf1), grad(bb, xf1, yf1), u);
+	__m128 res = lerp(x1, x2, v);
+	return _mm_max_ps(_mm_min_ps(res, _mm_set1_ps(1.0f)), _mm_set1_ps(-1.0f));
+}
+
+NOISE_SSE42 static void noiseRow(const int* perm, int mask, float y, float x0, float dx, int count, float* out, float frequency, float amp) {
+	const __m128 ys = _mm_set1_ps(y * frequency);
+	const __m128 vf = _mm_set1_ps(frequency);
+	const __m128 va = _mm_set1_ps(amp);
+	const __m128 vdx = _mm_set1_ps(dx);
+	const __m128i lane = _mm_setr_epi32(0, 1, 2, 3);
+	for (int i = 0; i < count; i += 4) {
+		__m128 xs = _mm_mul_ps(_mm_add_ps(_mm_set1_ps(x0), _mm_mul_ps(_mm_cvtepi32_ps(_mm_add_epi32(_mm_set1_epi32(i), lane)), vdx)), vf);
+		__m128 r = _mm_mul_ps(noise(perm, mask, xs, ys), va);
+		if (i + 4 <= count) {
+			_mm_storeu_ps(out + i, _mm_add_ps(_mm_loadu_ps(out + i), r));
+		} else {
+			alignas(16) float tmp[4];
+			_mm_store_ps(tmp, r);
+			for (int l = 0; i + l < count; l++) out[i + l] += tmp[l];
+		}
+	}
+}
+
+NOISE_SSE42 static void noisePoints(const int* perm, int mask, const float* xs, const float* ys, int count, float* out, float frequency, float amp) {
+	const __m128 vf = _mm_set1_ps(frequency);
+	const __m128 va = _mm_set1_ps(amp);
+	for (int i = 0; i < count; i += 4) {
+		alignas(16) float bx[4] = {0}, by[4] = {0}, bo[4] = {0};
+		int n = count - i < 4 ? count - i : 4;
+		std::memcpy(bx, xs + i, n * sizeof(float));
+		std::memcpy(by, ys + i, n * sizeof(float));
+		std::memcpy(bo, out + i, n * sizeof(float));
+		__m128 r = _mm_mul_ps(noise(perm, mask, _mm_mul_ps(_mm_load_ps(bx), vf), _mm_mul_ps(_mm_load_ps(by), vf)), va);
+		_mm_store_ps(bo, _mm_add_ps(_mm_load_ps(bo), r));
+		std::memcpy(out + i, bo, n * sizeof(float));
+	}
+}
+
+}  // namespace sse42
+
+// ---------------- AVX2 (8 lanes, hardware gather) ----------------
+namespace avx2 {
+
+NOISE_AVX2 static inline __m256 fade(__m256 t) {
+	__m256 t3 = _mm256_mul_ps(_mm256_mul_ps(t, t), t);
+	__m256 in = _mm256_add_ps(_mm256_mul_ps(t, _mm256_sub_ps(_mm256_mul_ps(t, _mm256_set1_ps(6.0f)), _mm256_set1_ps(15.0f))), _mm256_set1_ps(10.0f));
+	return _mm256_mul_ps(t3, in);
+}
+
+NOISE_AVX2 static inline __m256 lerp(__m256 a, __m256 b, __m256 t) { return _mm256_add_ps(a, _mm256_mul_ps(t, _mm256_sub_ps(b, a))); }
+
+NOISE_AVX2 static inline __m256 grad(__m256i hash, __m256 x, __m256 y) {
+	__m256i h = _mm256_and_si256(hash, _mm256_set1_epi32(7));
+	__m256 swap = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(h, _mm256_set1_epi32(4)), _mm256_set1_epi32(4)));
+	__m256 u = _mm256_blendv_ps(x, y, swap);
+	__m256 v = _mm256_blendv_ps(y, x, swap);
+	__m256 su = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(h, _mm256_set1_epi32(1)), 31));
+	__m256 sv = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(h, _mm256_set1_epi32(2)), 30));
+	return _mm256_add_ps(_mm256_xor_ps(u, su), _mm256_xor_ps(v, sv));
+}
+
+NOISE_AVX2 static inline __m256 noise(const int* perm, int mask, __m256 x, __m256 y) {
+	__m256 fx = _mm256_floor_ps(x);
+	__m256 fy = _mm256_floor_ps(y);
+	__m256i xi = _mm256_and_si256(_mm256_cvttps_epi32(fx), _mm256_set1_epi32(mask));
+	__m256i yi = _mm256_and_si256(_mm256_cvttps_epi32(fy), _mm256_set1_epi32(mask));
+	__m256 xf = _mm256_sub_ps(x, fx);
+	__m256 yf = _mm256_sub_ps(y, fy);
+	__m256 u = fade(xf);
+	__m256 v = fade(yf);
+	__m256i one = _mm256_set1_epi32(1);
+	__m256i pa = _mm256_add_epi32(_mm256_i32gather_epi32(perm, xi, 4), yi);
+	__m256i pb = _mm256_add_epi32(_mm256_i32gather_epi32(perm, _mm256_add_epi32(xi, one), 4), yi);
+	__m256i aa = _mm256_i32gather_epi32(perm, pa, 4);
+	__m256i ab = _mm256_i32gather_epi32(perm, _mm256_add_epi32(pa, one), 4);
+	__m256i ba = _mm256_i32gather_epi32(perm, pb, 4);
+	__m256i bb = _mm256_i32gather_epi32(perm, _mm256_add_epi32(pb, one), 4);
+	__m256 xf1 = _mm256_sub_ps(xf, _mm256_set1_ps(1.0f));
+	__m256 yf1 = _mm256_sub_ps(yf, _mm256_set1_ps(1.0f));
+	__m256 x1 = lerp(grad(aa, xf, yf), grad(ba, xf1, yf), u);
+	__m256 x2 = lerp(grad(ab, xf, yf1), grad(bb, xf1, yf1), u);
+	__m256 res = lerp(x1, x2, v);
+	return _mm256_max_ps(_mm256_min_ps(res, _mm256_set1_ps(1.0f)), _mm256_set1_ps(-1.0f));
+}
+
+NOISE_AVX2 static void noiseRow(const int* perm, int mask, float y, float x0, float dx, int count, float* out, float frequency, float amp) {
+	const __m256 ys = _mm256_set1_ps(y * frequency);
+	const __m256 vf = _mm256_set1_ps(frequency);
+	const __m256 va = _mm256_set1_ps(amp);
+	const __m256 vdx = _mm256_set1_ps(dx);
+	const __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+	for (int i = 0; i < count; i += 8) {
+		__m256 xs = _mm256_mul_ps(_mm256_add_ps(_mm256_set1_ps(x0), _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_add_epi32(_mm256_set1_epi32(i), lane)), vdx)), vf);
+		__m256 r = _mm256_mul_ps(noise(perm, mask, xs, ys), va);
+		if (i + 8 <= count) {
+			_mm256_storeu_ps(out + i, _mm256_add_ps(_mm256_loadu_ps(out + i), r));
+		} else {
+			__m256i tail = _mm256_cmpgt_epi32(_mm256_set1_epi32(count - i), lane);
+			_mm256_maskstore_ps(out + i, tail, _mm256_add_ps(_mm256_maskload_ps(out + i, tail), r));
+		}
+	}
+}
+
+NOISE_AVX2 static void noisePoints(const int* perm, int mask, const float* xs, const float* ys, int count, float* out, float frequency, float amp) {
+	const __m256 vf = _mm256_set1_ps(frequency);
+	const __m256 va = _mm256_set1_ps(amp);
+	const __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+	for (int i = 0; i < count; i += 8) {
+		__m256i tail = _mm256_cmpgt_epi32(_mm256_set1_epi32(count - i), lane);
+		__m256 x = _mm256_mul_ps(_mm256_maskload_ps(xs + i, tail), vf);
+		__m256 y = _mm256_mul_ps(_mm256_maskload_ps(ys + i, tail), vf);
+		__m256 r = _mm256_mul_ps(noise(perm, mask, x, y), va);
+		_mm256_maskstore_ps(out + i, tail, _mm256_add_ps(_mm256_maskload_ps(out + i, tail), r));
+	}
+}
+
+}  // namespace avx2
+
+// ---------------- AVX-512F (16 lanes, hardware gather, mask registers) ----------------
+namespace avx512 {
+
+NOISE_AVX512 static inline __m512 fade(__m512 t) {
+	__m512 t3 = _mm512_mul_ps(_mm512_mul_ps(t, t), t);
+	__m512 in = _mm512_add_ps(_mm512_mul_ps(t, _mm512_sub_ps(_mm512_mul_ps(t, _mm512_set1_ps(6.0f)), _mm512_set1_ps(15.0f))), _mm512_set1_ps(10.0f));
+	return _mm512_mul_ps(t3, in);
+}
+
+NOISE_AVX512 static inline __m512 lerp(__m512 a, __m512 b, __m512 t) { return _mm512_add_ps(a, _mm512_mul_ps(t, _mm512_sub_ps(b, a))); }
+
+NOISE_AVX512 static inline __m512 grad(__m512i hash, __m512 x, __m512 y) {
+	__m512i h = _mm512_and_si512(hash, _mm512_set1_epi32(7));
+	__mmask16 swap = _mm512_test_epi32_mask(h, _mm512_set1_epi32(4));
+	__m512i u = _mm512_castps_si512(_mm512_mask_blend_ps(swap, x, y));
+	__m512i v = _mm512_castps_si512(_mm512_mask_blend_ps(swap, y, x));
+	__m512i su = _mm512_slli_epi32(_mm512_and_si512(h, _mm512_set1_epi32(1)), 31);
+	__m512i sv = _mm512_slli_epi32(_mm512_and_si512(h, _mm512_set1_epi32(2)), 30);
+	return _mm512_add_ps(_mm512_castsi512_ps(_mm512_xor_si512(u, su)), _mm512_castsi512_ps(_mm512_xor_si512(v, sv)));
+}
+
+NOISE_AVX512 static inline __m512 noise(const int* perm, int mask, __m512 x, __m512 y) {
+	__m512 fx = _mm512_roundscale_ps(x, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC);
+	__m512 fy = _mm512_roundscale_ps(y, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC);
+	__m512i xi = _mm512_and_si512(_mm512_cvttps_epi32(fx), _mm512_set1_epi32(mask));
+	__m512i yi = _mm512_and_si512(_mm512_cvttps_epi32(fy), _mm512_set1_epi32(mask));
+	__m512 xf = _mm512_sub_ps(x, fx);
+	__m512 yf = _mm512_sub_ps(y, fy);
+	__m512 u = fade(xf);
+	__m512 v = fade(yf);
+	__m512i one = _mm512_set1_epi32(1);
+	__m512i pa = _mm512_add_epi32(_mm512_i32gather_epi32(xi, perm, 4), yi);
+	__m512i pb = _mm512_add_epi32(_mm512_i32gather_epi32(_mm512_add_epi32(xi, one), perm, 4), yi);
+	__m512i aa = _mm512_i32gather_epi32(pa, perm, 4);
+	__m512i ab = _mm512_i32gather_epi32(_mm512_add_epi32(pa, one), perm, 4);
+	__m512i ba = _mm512_i32gather_epi32(pb, perm, 4);
+	__m512i bb = _mm512_i32gather_epi32(_mm512_add_epi32(pb, one), perm, 4);
+	__m512 xf1 = _mm512_sub_ps(xf, _mm512_set1_ps(1.0f));
+	__m512 yf1 = _mm512_sub_ps(yf, _mm512_set1_ps(1.0f));
+	__m512 x1 = lerp(grad(aa, xf, yf), grad(ba, xf1, yf), u);
+	__m512 x2 = lerp(grad(ab, xf, yf1), grad(bb, xf1, yf1), u);
+	__m512 res = lerp(x1, x2, v);
+	return _mm512_max_ps(_mm512_min_ps(res, _mm512_set1_ps(1.0f)), _mm512_set1_ps(-1.0f));
+}
+
+NOISE_AVX512 static void noiseRow(const int* perm, int mask, float y, float x0, float dx, int count, float* out, float frequency, float amp) {
+	const __m512 ys = _mm512_set1_ps(y * frequency);
+	const __m512 vf = _mm512_set1_ps(frequency);
+	const __m512 va = _mm512_set1_ps(amp);
+	const __m512 vdx = _mm512_set1_ps(dx);
+	const __m512i lane = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+	for (int i = 0; i < count; i += 16) {
+		__m512 xs = _mm512_mul_ps(_mm512_add_ps(_mm512_set1_ps(x0), _mm512_mul_ps(_mm512_cvtepi32_ps(_mm512_add_epi32(_mm512_set1_epi32(i), lane)), vdx)), vf);
+		__m512 r = _mm512_mul_ps(noise(perm, mask, xs, ys), va);
+		__mmask16 m = count - i >= 16 ? (__mmask16)0xFFFF : (__mmask16)((1u << (count - i)) - 1u);
+		_mm512_mask_storeu_ps(out + i, m, _mm512_add_ps(_mm512_maskz_loadu_ps(m, out + i), r));
+	}
+}
+
+NOISE_AVX512 static void noisePoints(const int* perm, int mask, const float* xs, const float* ys, int count, float* out, float frequency, float amp) {
+	const __m512 vf = _mm512_set1_ps(frequency);
+	const __m512 va = _mm512_set1_ps(amp);
+	for (int i = 0; i < count; i += 16) {
+		__mmask16 m = count - i >= 16 ? (__mmask16)0xFFFF : (__mmask16)((1u << (count - i)) - 1u);
+		__m512 x = _mm512_mul_ps(_mm512_maskz_loadu_ps(m, xs + i), vf);
+		__m512 y = _mm512_mul_ps(_mm512_maskz_loadu_ps(m, ys + i), vf);
+		__m512 r = _mm512_mul_ps(noise(perm, mask, x, y), va);
+		_mm512_mask_storeu_ps(out + i, m, _mm512_add_ps(_mm512_maskz_loadu_ps(m, out + i), r));
+	}
+}
+
+}  // namespace avx512
+
+static Isa hostIsa() {
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512f")) return Isa::AVX512;
+	if (__builtin_cpu_supports("avx2")) return Isa::AVX2;
+	if (__builtin_cpu_supports("sse4.2")) return Isa::SSE42;
+	return Isa::Scalar;
+}
+
+#else
+
+static Isa hostIsa() { return Isa::Scalar; }
+
+#endif	// NOISE_SIMD_X86
+
+static Kernels kernelsFor(Isa isa) {
+	Kernels k;
+#if NOISE_SIMD_X86
+	switch (isa) {
+		case Isa::AVX512:
+			k = {Isa::AVX512, 16, avx512::noiseRow, avx512::noisePoints};
+			break;
+		case Isa::AVX2:
+			k = {Isa::AVX2, 8, avx2::noiseRow, avx2::noisePoints};
+			break;
+		case Isa::SSE42:
+			k = {Isa::SSE42, 4, sse42::noiseRow, sse42::noisePoints};
+			break;
+		default:
+			break;
+	}
+#else
+	(void)isa;
+#endif
+	return k;
+}
+
+static Kernels selectKernels() {
+	Isa isa = hostIsa();
+	if (const char* env = std::getenv("TERRAIN_NOISE_ISA")) {
+		Isa cap = isa;
+		if (std::strcmp(env, "scalar") == 0)
+			cap = Isa::Scalar;
+		else if (std::strcmp(env, "sse42") == 0)
+			cap = Isa::SSE42;
+		else if (std::strcmp(env, "avx2") == 0)
+			cap = Isa::AVX2;
+		else if (std::strcmp(env, "avx512") == 0)
+			cap = Isa::AVX512;
+		if ((int)cap < (int)isa) isa = cap;
+	}
+	return kernelsFor(isa);
+}
+
+const Kernels& kernels() {
+	static const Kernels k = selectKernels();
+	return k;
+}
+
+const char* isaName(Isa isa) {
+	switch (isa) {
+		case Isa::SSE42:
+			return "sse4.2";
+		case Isa::AVX2:
+			return "avx2";
+		case Isa::AVX512:
+			return "avx512";
+		default:
+			return "scalar";
+	}
+}
+
+}  // namespace noise_simd
@@ -0,0 +1,30 @@
+#pragma once
+
+// batched perlin kernels (SSE4.2 / AVX2 / AVX-512) picked once at startup from the host cpu.
+// every kernel follows the exact operation order of PerlinNoise::noise(), so results are
+// bit-identical to the scalar path on any host.
+//
+// TERRAIN_NOISE_ISA=scalar|sse42|avx2|avx512 caps the selected level (handy for A/B runs).
+
+namespace noise_simd {
+
+enum class Isa { Scalar, SSE42, AVX2, AVX512 };
+
+// out[i] += amp * noise(x0 + i * dx, y) for a row of samples, frequency already folded into the call.
+// lattice coords wrap with `mask`, so the perm table (stored twice) must have a power-of-two size
+using NoiseRowFn = void (*)(const int* perm, int mask, float y, float x0, float dx, int count, float* out, float frequency, float amp);
+// out[i] += amp * noise(xs[i], ys[i]) for scattered samples
+using NoisePointsFn = void (*)(const int* perm, int mask, const float* xs, const float* ys, int count, float* out, float frequency, float amp);
+
+struct Kernels {
+	Isa isa = Isa::Scalar;
+	int width = 1;	// lanes per call of the inner kernel
+	// null for Isa::Scalar, callers use their own scalar path then
+	NoiseRowFn noiseRow = nullptr;
+	NoisePointsFn noisePoints = nullptr;
+};
+
+const Kernels& kernels();
+const char* isaName(Isa isa);
+
+}  // namespace noise_simd
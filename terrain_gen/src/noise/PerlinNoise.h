@@ -2,62 +2,216 @@
 #include <omp.h>
 
 #include <algorithm>
+#include <cassert>
 #include <cmath>
 #include <cstdint>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
+#include "NoiseSimd.h"
 #include "util.h"
 
 using ll = long long;
 
-class PerlinNoise {
-   public:
-	explicit PerlinNoise(int seed = 1337, int permSize = 256) { init(seed, permSize); }
-	void init(int seed, int permSize = 256) {
-		permSize_ = permSize;
+// per-octave frequency multipliers and amplitudes of one fbm configuration plus its normalization.
+// entries are the same running products fbm() builds, so table-driven results match it exactly.
+// holds up to kMaxOctaves (past that the octave frequencies leave float precision); the unrolled
+// fbm<N>() / fbmRow<N>() paths are instantiated up to kMaxUnrolledOctaves, deeper tables run the
+// runtime-octave table loops
+struct FbmTable {
+	static constexpr int kMaxOctaves = 32;
+	static constexpr int kMaxUnrolledOctaves = 12;
+	int octaves = 0;
+	float freq[kMaxOctaves] = {};
+	float amp[kMaxOctaves] = {};
+	float maxAmp = 0.0f;
+
+	constexpr FbmTable() = default;
+	constexpr FbmTable(int numOctaves, float lacunarity, float gain) : octaves(std::clamp(numOctaves, 0, kMaxOctaves)) {
+		float a = 1.0f;
+		float f = 1.0f;
+		for (int i = 0; i < octaves; i++) {
+			freq[i] = f;
+			amp[i] = a;
+			maxAmp += a;
+			a *= gain;
+			f *= lacunarity;
+		}
+	}
+
+	// copy of this table for samples spaced `footprint` world units apart. octaves above 0.25 cycles
+	// per sample fade out linearly and octaves at or above nyquist (0.5) are dropped, so coarse passes
+	// run fewer octaves. maxAmp is kept so a coarse field matches the full one minus the lost detail
+	FbmTable bandLimited(float baseFreq, float footprint) const {
+		FbmTable t = *this;
+		int last = 0;
+		for (int i = 0; i < octaves; i++) {
+			float cycles = baseFreq * freq[i] * footprint;
+			float w = std::clamp((0.5f - cycles) * 4.0f, 0.0f, 1.0f);
+			if (w < 1.0f) t.amp[i] = amp[i] * w;
+			if (w > 0.0f) last = i + 1;
+		}
+		t.octaves = last;
+		return t;
+	}
+};
+
+// calls fn(std::integral_constant<int, N>{}) with N == octaves; false if octaves is outside [1, kMaxUnrolledOctaves]
+template <typename Fn, int... I>
+inline bool withFbmOctavesImpl(int octaves, Fn&& fn, std::integer_sequence<int, I...>) {
+	bool hit = false;
+	((octaves == I + 1 ? (fn(std::integral_constant<int, I + 1>{}), hit = true) : false), ...);
+	return hit;
+}
+
+template <typename Fn>
+inline bool withFbmOctaves(int octaves, Fn&& fn) {
+	return withFbmOctavesImpl(octaves, std::forward<Fn>(fn), std::make_integer_sequence<int, FbmTable::kMaxUnrolledOctaves>{});
+}
+
+// domain warp for fbm: the base field is sampled at p + strength * (wx(p), wy(p)), where wx / wy are
+// fbm of `table` at `frequency`, read from two far apart rows of the same noise so they decorrelate
+struct DomainWarp {
+	static constexpr float kRowX = 1237.0f;	 // y offset of the wx field
+	static constexpr float kRowY = -3571.0f;  // y offset of the wy field
+	FbmTable table;
+	float frequency = 0.002f;
+	float strength = 0.0f;	// world units, 0 = off
+	bool enabled() const { return strength != 0.0f && table.octaves > 0; }
+};
+
+// classic permutation-table lattice. the shuffled table is stored twice so corner lookups never
+// wrap; lattice coordinates repeat every `size` cells
+struct PermLattice {
+	static constexpr bool kHasTable = true;
+	std::vector<int> p;
+	int size = 256;
+
+	void init(int seed, int permSize) {
+		size = permSize;
 		rng_util::RNG rng(seed);
-		_p.resize(permSize_);
+		p.resize(size);
 
 		// cab just use iota but lets just parallelize it cz why tf not
 #pragma omp parallel for schedule(static)
-		for (int i = 0; i < permSize_; i++) {
-			_p[i] = i;
+		for (int i = 0; i < size; i++) {
+			p[i] = i;
 		}
 
-		for (int i = permSize_ - 1; i > 0; --i) {
+		for (int i = size - 1; i > 0; --i) {
 			uint32_t r = static_cast<uint32_t>(rng.nextInt());
 			int j = static_cast<int>(r % static_cast<uint32_t>(i + 1));
 			if (j < 0) j = 0;
 			if (j > i) j = i;
-			std::swap(_p[i], _p[j]);
+			std::swap(p[i], p[j]);
 		}
 
-		_p.resize(permSize_ * 2);
+		p.resize(size * 2);
 #pragma omp parallel for schedule(static)
-		for (int i = 0; i < permSize_; i++) {
-			_p[i + permSize_] = _p[i];
+		for (int i = 0; i < size; i++) {
+			p[i + size] = p[i];
 		}
 	}
 
+	// the simd kernels wrap with a mask, so they only apply to power-of-two tables
+	bool pow2() const { return size > 0 && (size & (size - 1)) == 0; }
+	inline int wrap(int c) const {
+		if (pow2()) return c & (size - 1);
+		int m = c % size;
+		return m < 0 ? m + size : m;
+	}
+	inline void corners(int cx, int cy, int& aa, int& ab, int& ba, int& bb) const {
+		int xi = wrap(cx);
+		int yi = wrap(cy);
+		aa = p[p[xi] + yi];
+		ab = p[p[xi] + yi + 1];
+		ba = p[p[xi + 1] + yi];
+		bb = p[p[xi + 1] + yi + 1];
+	}
+};
+
+// stateless lattice: corner gradients come from an integer hash of (seed, ix, iy), so there is
+// nothing to build or store per instance. period 0 never repeats, period > 0 wraps like a table would
+struct HashLattice {
+	static constexpr bool kHasTable = false;
+	uint32_t seed = 1337;
+	int period = 0;
+
+	static inline int hash(uint32_t seed, int ix, int iy) {
+		uint32_t h = (uint32_t)ix * 0x8da6b343u + (uint32_t)iy * 0xd8163841u + seed * 0xcb1ab31fu;
+		h ^= h >> 16;
+		h *= 0x7feb352du;
+		h ^= h >> 15;
+		h *= 0x846ca68bu;
+		h ^= h >> 16;
+		return (int)(h >> 29);	// grad() only looks at 3 bits, take the best mixed ones
+	}
+	inline int wrap(int c) const {
+		if (period <= 0) return c;
+		int m = c % period;
+		return m < 0 ? m + period : m;
+	}
+	inline void corners(int cx, int cy, int& aa, int& ab, int& ba, int& bb) const {
+		int x0 = wrap(cx), x1 = wrap(cx + 1);
+		int y0 = wrap(cy), y1 = wrap(cy + 1);
+		aa = hash(seed, x0, y0);
+		ab = hash(seed, x0, y1);
+		ba = hash(seed, x1, y0);
+		bb = hash(seed, x1, y1);
+	}
+};
+
+// perlin noise + fbm over a lattice policy (PermLattice / HashLattice), see PerlinNoise and HashedPerlinNoise
+template <class Lattice>
+class BasicPerlinNoise {
+   public:
 	float noise(float x, float y, float frequency = 1.0f) const {
 		x *= frequency;
 		y *= frequency;
-		int xi = fastfloor(x) & 255;
-		int yi = fastfloor(y) & 255;
 		float xf = x - floorf(x);
 		float yf = y - floorf(y);
 		float u = fade(xf);
 		float v = fade(yf);
-		int aa = _p[_p[xi] + yi];
-		int ab = _p[_p[xi] + yi + 1];
-		int ba = _p[_p[xi + 1] + yi];
-		int bb = _p[_p[xi + 1] + yi + 1];
+		int aa, ab, ba, bb;
+		lattice_.corners(fastfloor(x), fastfloor(y), aa, ab, ba, bb);
 		float x1 = lerp(grad(aa, xf, yf), grad(ba, xf - 1.0f, yf), u);
 		float x2 = lerp(grad(ab, xf, yf - 1.0f), grad(bb, xf - 1.0f, yf - 1.0f), u);
 		float res = lerp(x1, x2, v);
 		return std::clamp(res, -1.0f, 1.0f);
 	}
 
+	// noise() plus its analytic partial derivatives d/dx, d/dy (frequency included). the value is
+	// computed exactly like noise(); derivatives are 0 where the value got clamped
+	float noiseD(float x, float y, float frequency, float& dx, float& dy) const {
+		x *= frequency;
+		y *= frequency;
+		float xf = x - floorf(x);
+		float yf = y - floorf(y);
+		float u = fade(xf);
+		float v = fade(yf);
+		float du = fadeD(xf);
+		float dv = fadeD(yf);
+		int aa, ab, ba, bb;
+		lattice_.corners(fastfloor(x), fastfloor(y), aa, ab, ba, bb);
+		float naa = grad(aa, xf, yf), nba = grad(ba, xf - 1.0f, yf);
+		float nab = grad(ab, xf, yf - 1.0f), nbb = grad(bb, xf - 1.0f, yf - 1.0f);
+		float gaax, gaay, gbax, gbay, gabx, gaby, gbbx, gbby;
+		gradCoeffs(aa, gaax, gaay);
+		gradCoeffs(ba, gbax, gbay);
+		gradCoeffs(ab, gabx, gaby);
+		gradCoeffs(bb, gbbx, gbby);
+		float x1 = lerp(naa, nba, u);
+		float x2 = lerp(nab, nbb, u);
+		float res = lerp(x1, x2, v);
+		float d1x = lerp(gaax, gbax, u) + du * (nba - naa);
+		float d2x = lerp(gabx, gbbx, u) + du * (nbb - nab);
+		dx = lerp(d1x, d2x, v) * frequency;
+		dy = (lerp(lerp(gaay, gbay, u), lerp(gaby, gbby, u), v) + dv * (x2 - x1)) * frequency;
+		if (res < -1.0f || res > 1.0f) dx = dy = 0.0f;
+		return std::clamp(res, -1.0f, 1.0f);
+	}
+
 	float fbm(float x, float y, float baseFreq, int octaves, float lacunarity = 2.0f, float gain = 0.5f) const {
 		float amp = 1.0f;
 		float freq = 1.0f;
@@ -74,11 +228,216 @@ class PerlinNoise {
 		return std::clamp(sum, -1.0f, 1.0f);
 	}
 
+	// fbm() plus analytic d/dx, d/dy
+	float fbmD(float x, float y, float baseFreq, int octaves, float& dx, float& dy, float lacunarity = 2.0f, float gain = 0.5f) const {
+		float amp = 1.0f;
+		float freq = 1.0f;
+		float sum = 0.0f, sumDx = 0.0f, sumDy = 0.0f;
+		float maxAmp = 0.0f;
+		for (int i = 0; i < octaves; i++) {
+			float ndx, ndy;
+			float n = noiseD(x, y, baseFreq * freq, ndx, ndy);
+			sum += n * amp;
+			sumDx += ndx * amp;
+			sumDy += ndy * amp;
+			maxAmp += amp;
+			amp *= gain;
+			freq *= lacunarity;
+		}
+		if (maxAmp > 0.0f) {
+			sum /= maxAmp;
+			sumDx /= maxAmp;
+			sumDy /= maxAmp;
+		}
+		bool clamped = sum < -1.0f || sum > 1.0f;
+		dx = clamped ? 0.0f : sumDx;
+		dy = clamped ? 0.0f : sumDy;
+		return std::clamp(sum, -1.0f, 1.0f);
+	}
+
+	// fbm with the octave loop unrolled at compile time and the freq/amp products read from a table
+	template <int Octaves>
+	float fbm(float x, float y, float baseFreq, const FbmTable& t) const {
+		static_assert(Octaves >= 1 && Octaves <= FbmTable::kMaxUnrolledOctaves, "octave count out of range");
+		assert(t.octaves == Octaves);
+		float sum = unrolledOctaves(x, y, baseFreq, t, std::make_integer_sequence<int, Octaves>{});
+		if (t.maxAmp > 0.0f) sum /= t.maxAmp;
+		return std::clamp(sum, -1.0f, 1.0f);
+	}
+
+	// runtime-octave fbm from a table, any depth up to FbmTable::kMaxOctaves
+	float fbm(float x, float y, float baseFreq, const FbmTable& t) const { return tableFbm(x, y, baseFreq, t); }
+
+	// lacunarity 2 / gain 0.5 baked in, the whole table is a compile-time constant
+	template <int Octaves>
+	float fbm(float x, float y, float baseFreq) const {
+		return fbm<Octaves>(x, y, baseFreq, kHalfGainTable<Octaves>);
+	}
+
+	template <int Octaves>
+	static constexpr FbmTable kHalfGainTable = FbmTable(Octaves, 2.0f, 0.5f);
+
+	// fbm for `count` samples along one row, at (x0 + i, y). table lattices run the widest simd kernel
+	// the host supports (see NoiseSimd.h); the scalar path fetches the four corner hashes and gradients
+	// once per lattice cell per octave, only fade/lerp run per sample.
+	// output is bit-identical to calling fbm() for each sample
+	void fbmRow(float y, float x0, int count, float* out, float baseFreq, int octaves, float lacunarity = 2.0f, float gain = 0.5f) const {
+		if (count <= 0) return;
+		std::fill(out, out + count, 0.0f);
+		float amp = 1.0f;
+		float freq = 1.0f;
+		float maxAmp = 0.0f;
+		for (int i = 0; i < octaves; i++) {
+			rowOctave(y, x0, 1.0f, count, out, baseFreq * freq, amp);
+			maxAmp += amp;
+			amp *= gain;
+			freq *= lacunarity;
+		}
+		normalizeFbm(out, count, maxAmp);
+	}
+
+	// row evaluation with the octave loop unrolled, see fbm<Octaves>()
+	template <int Octaves>
+	void fbmRow(float y, float x0, int count, float* out, float baseFreq, const FbmTable& t) const {
+		static_assert(Octaves >= 1 && Octaves <= FbmTable::kMaxUnrolledOctaves, "octave count out of range");
+		assert(t.octaves == Octaves);
+		if (count <= 0) return;
+		std::fill(out, out + count, 0.0f);
+		unrolledRowOctaves(y, x0, count, out, baseFreq, t, std::make_integer_sequence<int, Octaves>{});
+		normalizeFbm(out, count, t.maxAmp);
+	}
+
+	// runtime-octave row evaluation from a table; samples at (x0 + i * dx, y)
+	void fbmRow(float y, float x0, int count, float* out, float baseFreq, const FbmTable& t, float dx = 1.0f) const {
+		if (count <= 0) return;
+		std::fill(out, out + count, 0.0f);
+		for (int i = 0; i < t.octaves; i++) rowOctave(y, x0, dx, count, out, baseFreq * t.freq[i], t.amp[i]);
+		normalizeFbm(out, count, t.maxAmp);
+	}
+
+	// fbmRow() plus analytic d/dx, d/dy per sample (scalar, lattice-coherent). values match fbmRow()
+	void fbmRowD(float y, float x0, int count, float* out, float* outDx, float* outDy, float baseFreq, const FbmTable& t, float dx = 1.0f) const {
+		if (count <= 0) return;
+		std::fill(out, out + count, 0.0f);
+		std::fill(outDx, outDx + count, 0.0f);
+		std::fill(outDy, outDy + count, 0.0f);
+		for (int i = 0; i < t.octaves; i++) noiseRowAccumulateD(y, x0, dx, count, out, outDx, outDy, baseFreq * t.freq[i], t.amp[i]);
+		for (int i = 0; i < count; i++) {
+			float sum = out[i];
+			if (t.maxAmp > 0.0f) {
+				sum /= t.maxAmp;
+				outDx[i] /= t.maxAmp;
+				outDy[i] /= t.maxAmp;
+			}
+			if (sum < -1.0f || sum > 1.0f) outDx[i] = outDy[i] = 0.0f;
+			out[i] = std::clamp(sum, -1.0f, 1.0f);
+		}
+	}
+
+	// fbm for a sample covering `footprint` world units, only the octaves that footprint can resolve are evaluated
+	float fbmBandLimited(float x, float y, float baseFreq, int octaves, float footprint, float lacunarity = 2.0f, float gain = 0.5f) const {
+		return tableFbm(x, y, baseFreq, FbmTable(octaves, lacunarity, gain).bandLimited(baseFreq, footprint));
+	}
+
+	// fbm at scattered sample positions (xs[i], ys[i]), batched through the simd kernels for table lattices
+	void fbmPoints(const float* xs, const float* ys, int count, float* out, float baseFreq, int octaves, float lacunarity = 2.0f,
+				   float gain = 0.5f) const {
+		if (count <= 0) return;
+		std::fill(out, out + count, 0.0f);
+		float amp = 1.0f;
+		float freq = 1.0f;
+		float maxAmp = 0.0f;
+		for (int i = 0; i < octaves; i++) {
+			pointsOctave(xs, ys, count, out, baseFreq * freq, amp);
+			maxAmp += amp;
+			amp *= gain;
+			freq *= lacunarity;
+		}
+		normalizeFbm(out, count, maxAmp);
+	}
+
+	// table-driven fbmPoints()
+	void fbmPoints(const float* xs, const float* ys, int count, float* out, float baseFreq, const FbmTable& t) const {
+		if (count <= 0) return;
+		std::fill(out, out + count, 0.0f);
+		for (int i = 0; i < t.octaves; i++) pointsOctave(xs, ys, count, out, baseFreq * t.freq[i], t.amp[i]);
+		normalizeFbm(out, count, t.maxAmp);
+	}
+
+	// domain-warped fbm at one point, see DomainWarp
+	float fbmWarped(float x, float y, float baseFreq, const FbmTable& t, const DomainWarp& w) const {
+		float wx = tableFbm(x, y + DomainWarp::kRowX, w.frequency, w.table);
+		float wy = tableFbm(x, y + DomainWarp::kRowY, w.frequency, w.table);
+		return tableFbm(x + w.strength * wx, y + w.strength * wy, baseFreq, t);
+	}
+
+	// domain-warped fbm along a row, matches fbmWarped() per sample. runs in spans of kWarpSpan samples
+	// through stack buffers, so tiled callers don't allocate per row. the warp fields use the coherent row
+	// kernels wherever a kernel restarted at the span start reproduces the positions x0 + i * dx exactly
+	// (see exactRowRestart), else the point path; the base then goes through the point path at the warped
+	// positions, the warp is smooth, so neighbouring samples mostly stay in the same lattice cell there too
+	static constexpr int kWarpSpan = 256;
+	void fbmRowWarped(float y, float x0, int count, float* out, float baseFreq, const FbmTable& t, const DomainWarp& w, float dx = 1.0f) const {
+		float xs[kWarpSpan], ys[kWarpSpan], wx[kWarpSpan], wy[kWarpSpan];
+		const bool unitRow = exactRowRestart(x0, count, dx);
+		for (int c = 0; c < count; c += kWarpSpan) {
+			const int n = std::min(kWarpSpan, count - c);
+			for (int i = 0; i < n; i++) xs[i] = x0 + (float)(c + i) * dx;
+			if (c == 0 || unitRow) {
+				fbmRow(y + DomainWarp::kRowX, xs[0], n, wx, w.frequency, w.table, dx);
+				fbmRow(y + DomainWarp::kRowY, xs[0], n, wy, w.frequency, w.table, dx);
+			} else {
+				std::fill(ys, ys + n, y + DomainWarp::kRowX);
+				fbmPoints(xs, ys, n, wx, w.frequency, w.table);
+				std::fill(ys, ys + n, y + DomainWarp::kRowY);
+				fbmPoints(xs, ys, n, wy, w.frequency, w.table);
+			}
+			for (int i = 0; i < n; i++) {
+				xs[i] += w.strength * wx[i];
+				ys[i] = y + w.strength * wy[i];
+			}
+			fbmPoints(xs, ys, n, out + c, baseFreq, t);
+		}
+	}
+
+	// fbmRowWarped() plus analytic d/dx, d/dy through the warp (chain rule over the warp jacobian), in the
+	// same spans; spans a row kernel can't restart on evaluate the warp fields per sample
+	void fbmRowWarpedD(float y, float x0, int count, float* out, float* outDx, float* outDy, float baseFreq, const FbmTable& t, const DomainWarp& w,
+					   float dx = 1.0f) const {
+		float a[kWarpSpan], ax[kWarpSpan], ay[kWarpSpan], b[kWarpSpan], bx[kWarpSpan], by[kWarpSpan];
+		const bool unitRow = exactRowRestart(x0, count, dx);
+		const float s = w.strength;
+		for (int c = 0; c < count; c += kWarpSpan) {
+			const int n = std::min(kWarpSpan, count - c);
+			if (c == 0 || unitRow) {
+				fbmRowD(y + DomainWarp::kRowX, x0 + (float)c * dx, n, a, ax, ay, w.frequency, w.table, dx);
+				fbmRowD(y + DomainWarp::kRowY, x0 + (float)c * dx, n, b, bx, by, w.frequency, w.table, dx);
+			} else {
+				for (int i = 0; i < n; i++) {
+					float px = x0 + (float)(c + i) * dx;
+					a[i] = tableFbmD(px, y + DomainWarp::kRowX, w.frequency, w.table, ax[i], ay[i]);
+					b[i] = tableFbmD(px, y + DomainWarp::kRowY, w.frequency, w.table, bx[i], by[i]);
+				}
+			}
+			for (int i = 0; i < n; i++) {
+				float gx, gy;
+				out[c + i] = tableFbmD((x0 + (float)(c + i) * dx) + s * a[i], y + s * b[i], baseFreq, t, gx, gy);
+				outDx[c + i] = gx * (1.0f + s * ax[i]) + gy * (s * bx[i]);
+				outDy[c + i] = gx * (s * ay[i]) + gy * (1.0f + s * by[i]);
+			}
+		}
+	}
+
+   protected:
+	Lattice lattice_;
+
    private:
-	std::vector<int> _p;
-	int permSize_ = 256;
+	// a row kernel started at x0 + c * dx lands on the same positions as one started at x0 (x0 + i * dx)
+	// for every span start c: unit steps from an integer, all within float's exact integer range
+	static bool exactRowRestart(float x0, int count, float dx) { return dx == 1.0f && x0 == std::floor(x0) && std::fabs(x0) + (float)count <= 16777216.0f; }
 	static inline int fastfloor(float x) { return (int)floorf(x); }
 	static inline float fade(float t) { return t * t * t * (t * (t * 6 - 15) + 10); }
+	static inline float fadeD(float t) { return 30.0f * t * t * (t * (t - 2.0f) + 1.0f); }
 	static inline float lerp(float a, float b, float t) { return a + t * (b - a); }
 	static inline float grad(int hash, float x, float y) {
 		int h = hash & 7;
@@ -86,4 +445,211 @@ class PerlinNoise {
 		float v = h < 4 ? y : x;
 		return ((h & 1) ? -u : u) + ((h & 2) ? -2.0f * v : 2.0f * v) * 0.5f;
 	}
+
+	// grad() written as gx * x + gy * y with gx, gy in {-1, 1}; exact, so results match grad()
+	static inline void gradCoeffs(int hash, float& gx, float& gy) {
+		int h = hash & 7;
+		float su = (h & 1) ? -1.0f : 1.0f;
+		float sv = (h & 2) ? -1.0f : 1.0f;
+		gx = h < 4 ? su : sv;
+		gy = h < 4 ? sv : su;
+	}
+
+	template <int... I>
+	float unrolledOctaves(float x, float y, float baseFreq, const FbmTable& t, std::integer_sequence<int, I...>) const {
+		float sum = 0.0f;
+		((sum += noise(x, y, baseFreq * t.freq[I]) * t.amp[I]), ...);
+		return sum;
+	}
+
+	template <int... I>
+	void unrolledRowOctaves(float y, float x0, int count, float* out, float baseFreq, const FbmTable& t, std::integer_sequence<int, I...>) const {
+		(rowOctave(y, x0, 1.0f, count, out, baseFreq * t.freq[I], t.amp[I]), ...);
+	}
+
+	// one octave of a row: simd kernel for power-of-two tables, lattice-coherent scalar otherwise
+	void rowOctave(float y, float x0, float dx, int count, float* out, float frequency, float amp) const {
+		if constexpr (Lattice::kHasTable) {
+			noise_simd::NoiseRowFn fn = noise_simd::kernels().noiseRow;
+			if (fn && lattice_.pow2()) return fn(lattice_.p.data(), lattice_.size - 1, y, x0, dx, count, out, frequency, amp);
+		}
+		noiseRowAccumulate(y, x0, dx, count, out, frequency, amp);
+	}
+
+	void pointsOctave(const float* xs, const float* ys, int count, float* out, float frequency, float amp) const {
+		if constexpr (Lattice::kHasTable) {
+			noise_simd::NoisePointsFn fn = noise_simd::kernels().noisePoints;
+			if (fn && lattice_.pow2()) return fn(lattice_.p.data(), lattice_.size - 1, xs, ys, count, out, frequency, amp);
+		}
+		noisePointsAccumulate(xs, ys, count, out, frequency, amp);
+	}
+
+	// adds amp * noise(xs[i], ys[i], frequency) to out[i]. corner hashes are only refetched when a
+	// sample leaves the previous sample's lattice cell, which for smooth paths (warped rows) is rare
+	void noisePointsAccumulate(const float* xs, const float* ys, int count, float* out, float frequency, float amp) const {
+		int cellX = 0, cellY = 0;
+		bool haveCell = false;
+		int aa = 0, ab = 0, ba = 0, bb = 0;
+		for (int i = 0; i < count; i++) {
+			float x = xs[i] * frequency;
+			float y = ys[i] * frequency;
+			int cx = fastfloor(x), cy = fastfloor(y);
+			if (!haveCell || cx != cellX || cy != cellY) {
+				cellX = cx;
+				cellY = cy;
+				haveCell = true;
+				lattice_.corners(cx, cy, aa, ab, ba, bb);
+			}
+			float xf = x - floorf(x);
+			float yf = y - floorf(y);
+			float u = fade(xf);
+			float v = fade(yf);
+			float x1 = lerp(grad(aa, xf, yf), grad(ba, xf - 1.0f, yf), u);
+			float x2 = lerp(grad(ab, xf, yf - 1.0f), grad(bb, xf - 1.0f, yf - 1.0f), u);
+			out[i] += std::clamp(lerp(x1, x2, v), -1.0f, 1.0f) * amp;
+		}
+	}
+
+	// runtime table fbm at one point, same sum / normalisation as the row paths
+	float tableFbm(float x, float y, float baseFreq, const FbmTable& t) const {
+		float sum = 0.0f;
+		for (int i = 0; i < t.octaves; i++) sum += noise(x, y, baseFreq * t.freq[i]) * t.amp[i];
+		if (t.maxAmp > 0.0f) sum /= t.maxAmp;
+		return std::clamp(sum, -1.0f, 1.0f);
+	}
+
+	float tableFbmD(float x, float y, float baseFreq, const FbmTable& t, float& dx, float& dy) const {
+		float sum = 0.0f;
+		dx = dy = 0.0f;
+		for (int i = 0; i < t.octaves; i++) {
+			float nx, ny;
+			sum += noiseD(x, y, baseFreq * t.freq[i], nx, ny) * t.amp[i];
+			dx += nx * t.amp[i];
+			dy += ny * t.amp[i];
+		}
+		if (t.maxAmp > 0.0f) {
+			sum /= t.maxAmp;
+			dx /= t.maxAmp;
+			dy /= t.maxAmp;
+		}
+		if (sum < -1.0f || sum > 1.0f) dx = dy = 0.0f;
+		return std::clamp(sum, -1.0f, 1.0f);
+	}
+
+	// noiseRowAccumulate() that also accumulates amp * d/dx, amp * d/dy
+	void noiseRowAccumulateD(float y, float x0, float dx, int count, float* out, float* outDx, float* outDy, float frequency, float amp) const {
+		float ys = y * frequency;
+		int cy = fastfloor(ys);
+		float yf = ys - floorf(ys);
+		float v = fade(yf);
+		float dv = fadeD(yf);
+
+		int cell = 0;
+		bool haveCell = false;
+		float gaa = 0, gba = 0, gab = 0, gbb = 0;
+		float haa = 0, hba = 0, hab = 0, hbb = 0;  // y coefficient per corner
+		float caa = 0, cba = 0, cab = 0, cbb = 0;
+		for (int i = 0; i < count; i++) {
+			float xs = (x0 + (float)i * dx) * frequency;
+			float fl = floorf(xs);
+			int c = (int)fl;
+			if (!haveCell || c != cell) {
+				cell = c;
+				haveCell = true;
+				int aa, ab, ba, bb;
+				lattice_.corners(c, cy, aa, ab, ba, bb);
+				gradCoeffs(aa, gaa, haa);
+				caa = haa * yf;
+				gradCoeffs(ba, gba, hba);
+				cba = hba * yf;
+				gradCoeffs(ab, gab, hab);
+				cab = hab * (yf - 1.0f);
+				gradCoeffs(bb, gbb, hbb);
+				cbb = hbb * (yf - 1.0f);
+			}
+			float xf = xs - fl;
+			float xf1 = xf - 1.0f;
+			float u = fade(xf);
+			float du = fadeD(xf);
+			float naa = gaa * xf + caa, nba = gba * xf1 + cba;
+			float nab = gab * xf + cab, nbb = gbb * xf1 + cbb;
+			float x1 = lerp(naa, nba, u);
+			float x2 = lerp(nab, nbb, u);
+			float res = lerp(x1, x2, v);
+			if (res >= -1.0f && res <= 1.0f) {
+				float d1x = lerp(gaa, gba, u) + du * (nba - naa);
+				float d2x = lerp(gab, gbb, u) + du * (nbb - nab);
+				outDx[i] += lerp(d1x, d2x, v) * frequency * amp;
+				outDy[i] += (lerp(lerp(haa, hba, u), lerp(hab, hbb, u), v) + dv * (x2 - x1)) * frequency * amp;
+			}
+			out[i] += std::clamp(res, -1.0f, 1.0f) * amp;
+		}
+	}
+
+	static inline void normalizeFbm(float* out, int count, float maxAmp) {
+		for (int i = 0; i < count; i++) {
+			float sum = out[i];
+			if (maxAmp > 0.0f) sum /= maxAmp;
+			out[i] = std::clamp(sum, -1.0f, 1.0f);
+		}
+	}
+
+	// adds amp * noise(x0 + i * dx, y, frequency) to out[i]
+	void noiseRowAccumulate(float y, float x0, float dx, int count, float* out, float frequency, float amp) const {
+		float ys = y * frequency;
+		int cy = fastfloor(ys);
+		float yf = ys - floorf(ys);
+		float v = fade(yf);
+
+		int cell = 0;
+		bool haveCell = false;
+		float gaa = 0, gba = 0, gab = 0, gbb = 0;	 // x coefficient per corner
+		float caa = 0, cba = 0, cab = 0, cbb = 0;	 // y term per corner, constant along the row
+		for (int i = 0; i < count; i++) {
+			float xs = (x0 + (float)i * dx) * frequency;
+			float fl = floorf(xs);
+			int c = (int)fl;
+			if (!haveCell || c != cell) {
+				cell = c;
+				haveCell = true;
+				int aa, ab, ba, bb;
+				lattice_.corners(c, cy, aa, ab, ba, bb);
+				float gy;
+				gradCoeffs(aa, gaa, gy);
+				caa = gy * yf;
+				gradCoeffs(ba, gba, gy);
+				cba = gy * yf;
+				gradCoeffs(ab, gab, gy);
+				cab = gy * (yf - 1.0f);
+				gradCoeffs(bb, gbb, gy);
+				cbb = gy * (yf - 1.0f);
+			}
+			float xf = xs - fl;
+			float xf1 = xf - 1.0f;
+			float u = fade(xf);
+			float x1 = lerp(gaa * xf + caa, gba * xf1 + cba, u);
+			float x2 = lerp(gab * xf + cab, gbb * xf1 + cbb, u);
+			float res = std::clamp(lerp(x1, x2, v), -1.0f, 1.0f);
+			out[i] += res * amp;
+		}
+	}
+};
+
+enum class NoiseBackend { Permutation, Hash };
+
+class PerlinNoise : public BasicPerlinNoise<PermLattice> {
+   public:
+	explicit PerlinNoise(int seed = 1337, int permSize = 256) { init(seed, permSize); }
+	void init(int seed, int permSize = 256) { lattice_.init(seed, permSize); }
+};
+
+// permutation-free backend: zero setup, no table, optionally non-repeating. cheap enough to make one
+// per chunk / tile with its own seed
+class HashedPerlinNoise : public BasicPerlinNoise<HashLattice> {
+   public:
+	explicit HashedPerlinNoise(uint32_t seed = 1337, int period = 0) { init(seed, period); }
+	void init(uint32_t seed, int period = 0) {
+		lattice_.seed = seed;
+		lattice_.period = period;
+	}
 };
@@ -9,6 +9,8 @@
 #include <iostream>
 #include <sstream>
 
+#include "Log.h"
+
 using json = nlohmann::json;
 
 ObjectPlacer::ObjectPlacer(int W_, int H_, float worldSizeMeters) : W(W_), H(H_), placedCount(0) {
@@ -233,9 +235,11 @@ void ObjectPlacer::place(const std::vector<float> &height, const std::vector<flo
 	placedCount.store(0, std::memory_order_relaxed);
 
 	uint64_t baseSeed = seed;
+	logging::Progress progress("[OBJECTS] rows", H, 1.0, logging::Level::Debug);
 // iterate raster
 #pragma omp parallel for schedule(dynamic)
 	for (int y = 0; y < H; y++) {
+		progress.add(1);
 		// quick early-skip by rows if already reached (cheap atomic read)
 		if (placedCount.load(std::memory_order_relaxed) >= globalMax) continue;
 
@@ -271,12 +275,19 @@ void ObjectPlacer::place(const std::vector<float> &height, const std::vector<flo
 			}
 		}
 	}
+	logging::flush();
+	if (placedCount.load(std::memory_order_relaxed) >= globalMax) LOG_WARN("[OBJECTS] hit global_max_instances (" << globalMax << "), rest of the map skipped");
+	LOG_INFO("[OBJECTS] placed " << placed.size() << " instances");
 }
 
 const std::vector<ObjInstance> &ObjectPlacer::instances() const { return placed; }
 
 void ObjectPlacer::writeCSV(const std::string &path) const {
 	std::ofstream f(path);
+	if (!f) {
+		LOG_ERROR("[OBJECTS] cannot write " << path);
+		return;
+	}
 	f << "id,name,model,px,py,wx,wy,wz,yaw,scale,biome\n";
 
 	// Pre-allocate string buffer for better performance
@@ -320,6 +331,10 @@ void ObjectPlacer::writeDebugPPM(const std::string &path) const {
 	}
 
 	std::ofstream f(path, std::ios::binary);
+	if (!f) {
+		LOG_ERROR("[OBJECTS] cannot write " << path);
+		return;
+	}
 	f << "P6\n" << W << " " << H << "\n255\n";
 	f.write(reinterpret_cast<char *>(img.data()), img.size());
 	f.close();
@@ -0,0 +1,200 @@
+#pragma once
+#include <omp.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+// leveled logging to stderr.
+//
+//   LOG_INFO("[EROSION] droplets=" << n);
+//
+// - compile time: levels above TERRAIN_LOG_MAX_LEVEL (0 error .. 4 trace, default 3 = debug) compile to
+//   nothing, arguments included, so LOG_TRACE in a hot loop is free in normal builds
+// - runtime: logging::setLevel() or TERRAIN_LOG_LEVEL=error|warn|info|debug|trace, default info. a
+//   disabled level costs one relaxed atomic load
+// - lines are formatted into a per-thread buffer. outside parallel regions (and for errors / warnings)
+//   a line goes out right away; inside one it stays in the thread's buffer until that holds a few KB
+//   or logging::flush() runs, so worker threads never serialise on the stream per line
+// - logging::Progress prints "name: done/total (pct)" at most once per interval, from any thread
+#ifndef TERRAIN_LOG_MAX_LEVEL
+#define TERRAIN_LOG_MAX_LEVEL 3
+#endif
+
+namespace logging {
+
+enum class Level { Error = 0, Warn = 1, Info = 2, Debug = 3, Trace = 4 };
+
+inline const char* levelName(Level l) {
+	switch (l) {
+		case Level::Error:
+			return "error";
+		case Level::Warn:
+			return "warn";
+		case Level::Info:
+			return "info";
+		case Level::Debug:
+			return "debug";
+		default:
+			return "trace";
+	}
+}
+
+// "error" .. "trace" (or 0 .. 4), anything else gives `fallback`
+inline Level parseLevel(const char* s, Level fallback) {
+	if (!s || !*s) return fallback;
+	for (int i = 0; i <= (int)Level::Trace; i++)
+		if (std::strcmp(s, levelName((Level)i)) == 0) return (Level)i;
+	if (s[0] >= '0' && s[0] <= '4' && s[1] == '\0') return (Level)(s[0] - '0');
+	return fallback;
+}
+
+namespace detail {
+inline std::atomic<int>& runtimeLevel() {
+	static std::atomic<int> level{(int)parseLevel(std::getenv("TERRAIN_LOG_LEVEL"), Level::Info)};
+	return level;
+}
+
+inline std::mutex& sinkMutex() {
+	static std::mutex m;
+	return m;
+}
+
+inline void write(const std::string& s) {
+	if (s.empty()) return;
+	std::lock_guard<std::mutex> lock(sinkMutex());
+	std::fwrite(s.data(), 1, s.size(), stderr);
+	std::fflush(stderr);
+}
+
+// one per thread that ever logged, kept alive by the registry so flush() can drain the pool threads
+struct ThreadBuffer {
+	std::mutex m;  // owner vs flush(), uncontended in practice
+	std::string pending;
+	std::ostringstream fmt;
+};
+
+inline std::vector<std::shared_ptr<ThreadBuffer>>& registry() {
+	static std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+	return buffers;
+}
+
+inline ThreadBuffer& threadBuffer() {
+	thread_local std::shared_ptr<ThreadBuffer> buf = [] {
+		auto b = std::make_shared<ThreadBuffer>();
+		std::lock_guard<std::mutex> lock(sinkMutex());
+		registry().push_back(b);
+		return b;
+	}();
+	return *buf;
+}
+
+constexpr size_t kFlushBytes = 4096;
+}  // namespace detail
+
+inline void setLevel(Level l) { detail::runtimeLevel().store((int)l, std::memory_order_relaxed); }
+inline Level level() { return (Level)detail::runtimeLevel().load(std::memory_order_relaxed); }
+inline bool enabled(Level l) { return (int)l <= detail::runtimeLevel().load(std::memory_order_relaxed); }
+
+// write out every thread's buffered lines. call outside parallel regions
+inline void flush() {
+	std::vector<std::shared_ptr<detail::ThreadBuffer>> buffers;
+	{
+		std::lock_guard<std::mutex> lock(detail::sinkMutex());
+		buffers = detail::registry();
+	}
+	for (auto& b : buffers) {
+		std::string out;
+		{
+			std::lock_guard<std::mutex> lock(b->m);
+			out.swap(b->pending);
+		}
+		detail::write(out);
+	}
+}
+
+// one log line, built in the thread's buffer and handed over on destruction
+class Line {
+   public:
+	explicit Line(Level l) : level_(l), buf_(detail::threadBuffer()) {
+		buf_.fmt.str(std::string());
+		buf_.fmt.clear();
+		if (l <= Level::Warn) buf_.fmt << '[' << levelName(l) << "] ";
+	}
+	~Line() {
+		buf_.fmt << '\n';
+		std::string out;
+		{
+			std::lock_guard<std::mutex> lock(buf_.m);
+			buf_.pending += buf_.fmt.str();
+			if (level_ <= Level::Warn || !omp_in_parallel() || buf_.pending.size() >= detail::kFlushBytes) out.swap(buf_.pending);
+		}
+		detail::write(out);
+	}
+	Line(const Line&) = delete;
+	Line& operator=(const Line&) = delete;
+
+	std::ostream& stream() { return buf_.fmt; }
+
+   private:
+	Level level_;
+	detail::ThreadBuffer& buf_;
+};
+
+// rate-limited progress of a counted job: add() from any thread, a line at most every `interval` seconds
+// (and once when done reaches total). add() is an atomic add plus a clock read, call it per chunk of work
+class Progress {
+   public:
+	Progress(std::string name, long long total, double intervalSec = 1.0, Level l = Level::Info)
+		: name_(std::move(name)), total_(total), interval_(intervalSec), level_(l), start_(std::chrono::steady_clock::now()) {}
+
+	void add(long long n) {
+		if (!enabled(level_)) return;
+		long long done = done_.fetch_add(n, std::memory_order_relaxed) + n;
+		double now = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count();
+		double last = last_.load(std::memory_order_relaxed);
+		bool finished = done >= total_;
+		if (!finished && now - last < interval_) return;
+		if (finished && reportedDone_.exchange(true)) return;
+		if (!finished && !last_.compare_exchange_strong(last, now)) return;	 // another thread reports this tick
+		Line line(level_);
+		line.stream() << name_ << ": " << done << "/" << total_ << " (" << (total_ > 0 ? (int)(100.0 * (double)done / (double)total_) : 100) << "%, "
+					  << now << " s)";
+	}
+
+   private:
+	std::string name_;
+	long long total_;
+	double interval_;
+	Level level_;
+	std::chrono::steady_clock::time_point start_;
+	std::atomic<long long> done_{0};
+	std::atomic<double> last_{0.0};
+	std::atomic<bool> reportedDone_{false};
+};
+
+}  // namespace logging
+
+#define TERRAIN_LOG(lvl, expr)                                                             \
+	do {                                                                                   \
+		if constexpr ((int)(lvl) <= TERRAIN_LOG_MAX_LEVEL) {                               \
+			if (::logging::enabled(lvl)) {                                                 \
+				::logging::Line terrainLogLine_(lvl);                                      \
+				terrainLogLine_.stream() << expr;                                          \
+			}                                                                              \
+		}                                                                                  \
+	} while (0)
+
+#define LOG_ERROR(expr) TERRAIN_LOG(::logging::Level::Error, expr)
+#define LOG_WARN(expr) TERRAIN_LOG(::logging::Level::Warn, expr)
+#define LOG_INFO(expr) TERRAIN_LOG(::logging::Level::Info, expr)
+#define LOG_DEBUG(expr) TERRAIN_LOG(::logging::Level::Debug, expr)
+#define LOG_TRACE(expr) TERRAIN_LOG(::logging::Level::Trace, expr)
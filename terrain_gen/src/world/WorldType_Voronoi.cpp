@@ -2,12 +2,53 @@
 
 #include <util.h>
 
+#include "Log.h"
+
 #include <algorithm>
 #include <cmath>
 
 WorldType_Voronoi::WorldType_Voronoi(int width, int height, const VoronoiConfig& cfg) : width_(width), height_(height), cfg_(cfg) {
 	noise_.init(cfg.seed + 12345);
+	hashNoise_.init((uint32_t)(cfg.seed + 12345));
 	initPlates();
+	initPlateIndex();
+	if (cfg_.plateRaster) initPlateRasters();
+	initFbm();
+}
+
+void WorldType_Voronoi::initFbm() {
+	// every fbm path (band limited or not, warped, lod) runs from octave tables; deeper octaves would
+	// sit below float precision of the sample positions anyway
+	if (cfg_.fbmOctaves > FbmTable::kMaxOctaves || (cfg_.warpStrength != 0.0f && cfg_.warpOctaves > FbmTable::kMaxOctaves))
+		LOG_WARN("fbm supports up to " << FbmTable::kMaxOctaves << " fbm / warp octaves, got " << cfg_.fbmOctaves << " / " << cfg_.warpOctaves << ", using "
+									   << FbmTable::kMaxOctaves);
+	FbmTable full(cfg_.fbmOctaves, cfg_.fbmLacunarity, cfg_.fbmGain);
+	fbmTable_ = cfg_.fbmBandLimit ? full.bandLimited(cfg_.fbmFrequency, 1.0f) : full;
+	bool trimmed = fbmTable_.octaves != full.octaves;
+	for (int i = 0; i < fbmTable_.octaves; i++) trimmed = trimmed || fbmTable_.amp[i] != full.amp[i];
+	bool baked = !trimmed && cfg_.fbmLacunarity == 2.0f && cfg_.fbmGain == 0.5f;
+	warp_ = warpFor(1.0f);
+	fbmAt_ = nullptr;
+	fbmRow_ = nullptr;
+	if (warp_.enabled()) return;  // warped rows/points go through the generic paths
+	if (fbmTable_.octaves > FbmTable::kMaxUnrolledOctaves) return;  // deeper than the specializations, runtime table loops
+	withNoise([&](const auto& noise) {
+		using Noise = std::decay_t<decltype(noise)>;
+		withFbmOctaves(fbmTable_.octaves, [&](auto n) {
+			constexpr int N = decltype(n)::value;
+			fbmAt_ = baked ? &WorldType_Voronoi::fbmBakedAt<Noise, N> : &WorldType_Voronoi::fbmTableAt<Noise, N>;
+			fbmRow_ = &WorldType_Voronoi::fbmTableRow<Noise, N>;
+		});
+	});
+}
+
+DomainWarp WorldType_Voronoi::warpFor(float sampleSpacing) const {
+	DomainWarp w;
+	FbmTable full(cfg_.warpOctaves, 2.0f, 0.5f);
+	w.table = cfg_.fbmBandLimit ? full.bandLimited(cfg_.warpFrequency, sampleSpacing) : full;
+	w.frequency = cfg_.warpFrequency;
+	w.strength = cfg_.warpStrength;
+	return w;
 }
 
 void WorldType_Voronoi::initPlates() {
@@ -30,28 +71,454 @@ void WorldType_Voronoi::initPlates() {
 }
 
 float WorldType_Voronoi::fbmNoiseAt(float fx, float fy) const {
-	return noise_.fbm(fx, fy, cfg_.fbmFrequency, cfg_.fbmOctaves, cfg_.fbmLacunarity, cfg_.fbmGain);
+	if (fbmAt_) return (this->*fbmAt_)(fx, fy);
+	if (warp_.enabled()) return withNoise([&](const auto& noise) { return noise.fbmWarped(fx, fy, cfg_.fbmFrequency, fbmTable_, warp_); });
+	return withNoise([&](const auto& noise) { return noise.fbm(fx, fy, cfg_.fbmFrequency, fbmTable_); });
+}
+
+void WorldType_Voronoi::fbmNoiseRow(int iy, int x0, int count, float* out) const {
+	if (fbmRow_) return (this->*fbmRow_)(iy, x0, count, out);
+	withNoise([&](const auto& noise) {
+		if (warp_.enabled())
+			noise.fbmRowWarped((float)iy, (float)x0, count, out, cfg_.fbmFrequency, fbmTable_, warp_);
+		else
+			noise.fbmRow((float)iy, (float)x0, count, out, cfg_.fbmFrequency, fbmTable_);
+	});
 }
 
-float WorldType_Voronoi::voronoiHeightAt(int ix, int iy) const {
-	float px = (float)ix + 0.5f;
-	float py = (float)iy + 0.5f;
-	float bestDist = 1e9f, secondDist = 1e9f;
-	const VoronoiPlate* bestPlate = nullptr;
+void WorldType_Voronoi::initPlateIndex() {
+	gridW_ = gridH_ = 0;
+	cellStart_.clear();
+	cellPlates_.clear();
+	if (plates_.size() < 64) return;	 // brute force is as fast below that
+
+	float minX = plates_[0].x, maxX = minX, minY = plates_[0].y, maxY = minY;
+	for (const auto& p : plates_) {
+		minX = std::min(minX, p.x);
+		maxX = std::max(maxX, p.x);
+		minY = std::min(minY, p.y);
+		maxY = std::max(maxY, p.y);
+	}
+	float area = std::max(1.0f, (maxX - minX) * (maxY - minY));
+	cellSize_ = std::max(1e-3f, std::sqrt(area * 2.0f / (float)plates_.size()));
+	gridX0_ = minX;
+	gridY0_ = minY;
+	gridW_ = std::max(1, (int)((maxX - minX) / cellSize_) + 1);
+	gridH_ = std::max(1, (int)((maxY - minY) / cellSize_) + 1);
+
+	auto cellOf = [&](const VoronoiPlate& p) {
+		int cx = std::min(gridW_ - 1, (int)((p.x - gridX0_) / cellSize_));
+		int cy = std::min(gridH_ - 1, (int)((p.y - gridY0_) / cellSize_));
+		return cy * gridW_ + cx;
+	};
+	cellStart_.assign((size_t)gridW_ * gridH_ + 1, 0);
+	for (const auto& p : plates_) cellStart_[cellOf(p) + 1]++;
+	for (size_t c = 1; c < cellStart_.size(); c++) cellStart_[c] += cellStart_[c - 1];
+	cellPlates_.resize(plates_.size());
+	std::vector<int> fill(cellStart_.begin(), cellStart_.end() - 1);
+	for (int i = 0; i < (int)plates_.size(); i++) cellPlates_[fill[cellOf(plates_[i])]++] = i;
+}
+
+NearestPlates WorldType_Voronoi::nearestPlatesBrute(float px, float py) const {
+	NearestPlates n;
 	for (const auto& p : plates_) {
 		float dx = px - p.x;
 		float dy = py - p.y;
 		float d = std::sqrt(dx * dx + dy * dy);
-		if (d < bestDist) {
-			secondDist = bestDist;
-			bestDist = d;
-			bestPlate = &p;
-		} else if (d < secondDist)
-			secondDist = d;
+		if (d < n.bestDist) {
+			n.secondDist = n.bestDist;
+			n.second = n.best;
+			n.bestDist = d;
+			n.best = &p;
+		} else if (d < n.secondDist) {
+			n.secondDist = d;
+			n.second = &p;
+		}
+	}
+	return n;
+}
+
+NearestPlates WorldType_Voronoi::nearestPlates(float px, float py) const {
+	if (gridW_ == 0) return nearestPlatesBrute(px, py);
+
+	// same answer as the brute-force scan: the two smallest (distance, plate index) pairs. rings of
+	// cells are visited around the query cell, candidates are rejected on squared distance first and
+	// only the survivors pay for the sqrt
+	NearestPlates n;
+	int bi = -1, si = -1;
+	float bestSq = 1e30f, secondSq = 1e30f;
+	auto consider = [&](int i) {
+		const VoronoiPlate& p = plates_[i];
+		float dx = px - p.x;
+		float dy = py - p.y;
+		float dsq = dx * dx + dy * dy;
+		if (dsq > secondSq * 1.000001f) return;	// sqrt is monotonic, can't beat (or tie) second
+		float d = std::sqrt(dsq);
+		if (d < n.bestDist || (d == n.bestDist && i < bi)) {
+			n.secondDist = n.bestDist;
+			si = bi;
+			secondSq = bestSq;
+			n.bestDist = d;
+			bi = i;
+			bestSq = dsq;
+		} else if (d < n.secondDist || (d == n.secondDist && i < si)) {
+			n.secondDist = d;
+			si = i;
+			secondSq = dsq;
+		}
+	};
+
+	int cx = std::clamp((int)std::floor((px - gridX0_) / cellSize_), 0, gridW_ - 1);
+	int cy = std::clamp((int)std::floor((py - gridY0_) / cellSize_), 0, gridH_ - 1);
+	for (int r = 0;; r++) {
+		int x0 = cx - r, x1 = cx + r, y0 = cy - r, y1 = cy + r;
+		auto visit = [&](int x, int y) {
+			int c = y * gridW_ + x;
+			for (int k = cellStart_[c]; k < cellStart_[c + 1]; k++) consider(cellPlates_[k]);
+		};
+		for (int y = std::max(0, y0); y <= std::min(gridH_ - 1, y1); y++) {
+			if (y == y0 || y == y1) {
+				for (int x = std::max(0, x0); x <= std::min(gridW_ - 1, x1); x++) visit(x, y);
+			} else {
+				if (x0 >= 0) visit(x0, y);
+				if (x1 < gridW_) visit(x1, y);
+			}
+		}
+		// the unvisited cells form up to four strips around the ring square (left / right full height,
+		// below / above between them). stop once the closest strip is provably farther than second; the
+		// margin keeps float rounding of the sqrt from turning a tie into a miss
+		int vx0 = std::max(0, x0), vx1 = std::min(gridW_ - 1, x1);
+		float bound = 1e30f;
+		bool more = false;
+		auto strip = [&](int ax, int ay, int bx, int by) {	// cells [ax, bx] x [ay, by]
+			if (ax > bx || ay > by) return;
+			more = true;
+			float rx0 = gridX0_ + (float)ax * cellSize_, rx1 = gridX0_ + (float)(bx + 1) * cellSize_;
+			float ry0 = gridY0_ + (float)ay * cellSize_, ry1 = gridY0_ + (float)(by + 1) * cellSize_;
+			float ex = std::max(0.0f, std::max(rx0 - px, px - rx1));
+			float ey = std::max(0.0f, std::max(ry0 - py, py - ry1));
+			bound = std::min(bound, std::sqrt(ex * ex + ey * ey));
+		};
+		strip(0, 0, vx0 - 1, gridH_ - 1);
+		strip(vx1 + 1, 0, gridW_ - 1, gridH_ - 1);
+		strip(vx0, 0, vx1, y0 - 1);
+		strip(vx0, y1 + 1, vx1, gridH_ - 1);
+		if (!more) break;
+		if (si >= 0 && n.secondDist < bound * 0.9999f) break;
+	}
+	n.best = bi >= 0 ? &plates_[bi] : nullptr;
+	n.second = si >= 0 ? &plates_[si] : nullptr;
+	return n;
+}
+
+void WorldType_Voronoi::initPlateRasters() {
+	const int np = (int)plates_.size();
+	plateId_.resize(width_, height_, -1);
+	secondId_.resize(width_, height_, -1);
+	plateDist_.resize(width_, height_, 1e9f);
+	secondDist_.resize(width_, height_, 1e9f);
+	if (np == 0) return;
+
+	// without cfg.plateRaster the rasters only exist for edits. they take the exact query then, so an
+	// edited world keeps the values a fresh generate() with the same plates gives
+	if (!cfg_.plateRaster) {
+#pragma omp parallel for schedule(static)
+		for (int y = 0; y < height_; y++) {
+			for (int x = 0; x < width_; x++) {
+				NearestPlates n = nearestPlates((float)x + 0.5f, (float)y + 0.5f);
+				plateId_(x, y) = n.best ? (int)(n.best - plates_.data()) : -1;
+				secondId_(x, y) = n.second ? (int)(n.second - plates_.data()) : -1;
+				plateDist_(x, y) = n.bestDist;
+				secondDist_(x, y) = n.secondDist;
+			}
+		}
+		return;
+	}
+
+	// flood over the map plus a margin towards off-map plates (at most half the map on each side),
+	// so their regions grow in from where they actually are. plates further out get clamped to the border
+	int ox = 0, oy = 0, ex = width_, ey = height_;
+	for (const auto& p : plates_) {
+		ox = std::min(ox, (int)std::floor(p.x));
+		oy = std::min(oy, (int)std::floor(p.y));
+		ex = std::max(ex, (int)std::floor(p.x) + 1);
+		ey = std::max(ey, (int)std::floor(p.y) + 1);
+	}
+	ox = std::max(ox, -width_ / 2);
+	oy = std::max(oy, -height_ / 2);
+	ex = std::min(ex, width_ + width_ / 2);
+	ey = std::min(ey, height_ + height_ / 2);
+	// the flood runs on cells of cs x cs pixels, ~8 cells across an average plate; the per-pixel pass
+	// below only needs a cell's plates and their neighbours to be right
+	const int cs = std::clamp((int)(std::sqrt((float)(ex - ox) * (float)(ey - oy) / (float)np) / 8.0f), 1, 16);
+	const int dw = (ex - ox + cs - 1) / cs, dh = (ey - oy + cs - 1) / cs;
+
+	// each cell keeps its two best plates (index, -1 = none) by squared distance while flooding
+	struct Seeds {
+		int a = -1, b = -1;
+	};
+	std::vector<Seeds> cur((size_t)dw * dh), next((size_t)dw * dh);
+	const float half = 0.5f * (float)cs;
+	auto distSq = [&](int i, int x, int y) {	// from the centre of flood cell (x, y)
+		float dx = (float)(x * cs + ox) + half - plates_[i].x;
+		float dy = (float)(y * cs + oy) + half - plates_[i].y;
+		return dx * dx + dy * dy;
+	};
+	auto offer = [](Seeds& s, float& da, float& db, int i, float d) {
+		if (i < 0 || i == s.a || i == s.b) return;
+		if (s.a < 0 || d < da || (d == da && i < s.a)) {
+			s.b = s.a;
+			db = da;
+			s.a = i;
+			da = d;
+		} else if (s.b < 0 || d < db || (d == db && i < s.b)) {
+			s.b = i;
+			db = d;
+		}
+	};
+	for (int i = 0; i < np; i++) {
+		int x = std::clamp(((int)std::floor(plates_[i].x) - ox) / cs, 0, dw - 1);
+		int y = std::clamp(((int)std::floor(plates_[i].y) - oy) / cs, 0, dh - 1);
+		Seeds& s = cur[(size_t)y * dw + x];
+		float da = s.a >= 0 ? distSq(s.a, x, y) : 1e30f, db = s.b >= 0 ? distSq(s.b, x, y) : 1e30f;
+		offer(s, da, db, i, distSq(i, x, y));
+	}
+
+	// jump flooding with steps N/2 .. 1 and one extra step-1 pass (JFA+1). every pass reads cur,
+	// writes next, rows in parallel
+	std::vector<int> steps;
+	for (int k = std::max(dw, dh) / 2; k >= 1; k /= 2) steps.push_back(k);
+	steps.push_back(1);
+	for (int step : steps) {
+#pragma omp parallel for schedule(static)
+		for (int y = 0; y < dh; y++) {
+			for (int x = 0; x < dw; x++) {
+				Seeds s;
+				float da = 1e30f, db = 1e30f;
+				for (int oyy = -1; oyy <= 1; oyy++) {
+					int ny = y + oyy * step;
+					if (ny < 0 || ny >= dh) continue;
+					for (int oxx = -1; oxx <= 1; oxx++) {
+						int nx = x + oxx * step;
+						if (nx < 0 || nx >= dw) continue;
+						const Seeds& n = cur[(size_t)ny * dw + nx];
+						if (n.a >= 0) offer(s, da, db, n.a, distSq(n.a, x, y));
+						if (n.b >= 0) offer(s, da, db, n.b, distSq(n.b, x, y));
+					}
+				}
+				next[(size_t)y * dw + x] = s;
+			}
+		}
+		cur.swap(next);
+	}
+
+	// plate adjacency seen in the flood (touching regions + nearest/second pairs). the true second
+	// nearest is always a delaunay neighbour of the nearest, so checking those repairs what the flood
+	// got wrong, which is mostly the second plate near triple points
+	std::vector<std::vector<int>> adj(np);
+	{
+		std::vector<std::pair<int, int>> pairs;
+		auto add = [&](int a, int b) {
+			if (a >= 0 && b >= 0 && a != b && (pairs.empty() || pairs.back() != std::make_pair(a, b))) pairs.emplace_back(a, b);
+		};
+		for (int y = 0; y < dh; y++) {
+			for (int x = 0; x < dw; x++) {
+				const Seeds& c = cur[(size_t)y * dw + x];
+				add(c.a, c.b);
+				if (x + 1 < dw) add(c.a, cur[(size_t)y * dw + x + 1].a);
+				if (y + 1 < dh) {
+					add(c.a, cur[(size_t)(y + 1) * dw + x].a);
+					if (x + 1 < dw) add(c.a, cur[(size_t)(y + 1) * dw + x + 1].a);
+					if (x > 0) add(c.a, cur[(size_t)(y + 1) * dw + x - 1].a);
+				}
+			}
+		}
+		// plates that lost their seed cell to two closer ones never flooded; tie them to that cell's winner
+		for (int i = 0; i < np; i++) {
+			int x = std::clamp(((int)std::floor(plates_[i].x) - ox) / cs, 0, dw - 1);
+			int y = std::clamp(((int)std::floor(plates_[i].y) - oy) / cs, 0, dh - 1);
+			add(cur[(size_t)y * dw + x].a, i);
+		}
+		for (auto& pr : pairs) {
+			adj[pr.first].push_back(pr.second);
+			adj[pr.second].push_back(pr.first);
+		}
+		for (auto& v : adj) {
+			std::sort(v.begin(), v.end());
+			v.erase(std::unique(v.begin(), v.end()), v.end());
+		}
+	}
+
+	// final pick per map pixel on the same float distances as nearestPlates(), ties by plate index
+#pragma omp parallel for schedule(static)
+	for (int y = 0; y < height_; y++) {
+		for (int x = 0; x < width_; x++) {
+			const Seeds& c = cur[(size_t)((y - oy) / cs) * dw + (x - ox) / cs];
+			Seeds s;
+			float da = 1e30f, db = 1e30f;
+			auto consider = [&](int i) {
+				float dx = (float)x + 0.5f - plates_[i].x;
+				float dy = (float)y + 0.5f - plates_[i].y;
+				offer(s, da, db, i, std::sqrt(dx * dx + dy * dy));
+			};
+			if (c.a >= 0) {
+				consider(c.a);
+				for (int i : adj[c.a]) consider(i);
+			}
+			if (c.b >= 0) {
+				consider(c.b);
+				for (int i : adj[c.b]) consider(i);
+			}
+			plateId_(x, y) = s.a;
+			secondId_(x, y) = s.b;
+			if (s.a >= 0) plateDist_(x, y) = da;
+			if (s.b >= 0) secondDist_(x, y) = db;
+		}
+	}
+}
+
+// runs fn(x, y) over the map in parallel, fn returns whether that pixel changed; gives their bbox
+template <class Fn>
+Rect WorldType_Voronoi::scanRasters(Fn&& fn) {
+	int minX = width_, minY = height_, maxX = -1, maxY = -1;
+#pragma omp parallel for schedule(static) reduction(min : minX, minY) reduction(max : maxX, maxY)
+	for (int y = 0; y < height_; y++) {
+		for (int x = 0; x < width_; x++) {
+			if (!fn(x, y)) continue;
+			minX = std::min(minX, x);
+			maxX = std::max(maxX, x);
+			minY = std::min(minY, y);
+			maxY = std::max(maxY, y);
+		}
 	}
+	return maxX < 0 ? Rect() : Rect(minX, minY, maxX - minX + 1, maxY - minY + 1);
+}
+
+Rect WorldType_Voronoi::markDirty(const Rect& r) {
+	dirty_ = dirty_.unite(r);
+	return r;
+}
+
+// re-resolves the rasters after plate `id` moved / was added (removed < 0), or after plate `removed`
+// was erased (id < 0). pixels that had the plate in their top two get a full query, everywhere else
+// the only possible change is the moved / new plate entering the top two
+Rect WorldType_Voronoi::requeryPlate(int id, int removed) {
+	if (!hasPlateRasters()) initPlateRasters();
+	const int gone = removed >= 0 ? removed : id;
+	return scanRasters([&](int x, int y) {
+		int& a = plateId_(x, y);
+		int& b = secondId_(x, y);
+		float px = (float)x + 0.5f, py = (float)y + 0.5f;
+		if ((a == gone || b == gone) && gone >= 0) {
+			NearestPlates n = nearestPlates(px, py);
+			a = n.best ? (int)(n.best - plates_.data()) : -1;
+			b = n.second ? (int)(n.second - plates_.data()) : -1;
+			plateDist_(x, y) = n.bestDist;
+			secondDist_(x, y) = n.secondDist;
+			return true;
+		}
+		if (removed >= 0) {
+			if (a > removed) a--;
+			if (b > removed) b--;
+			return false;
+		}
+		float dx = px - plates_[id].x;
+		float dy = py - plates_[id].y;
+		float dsq = dx * dx + dy * dy;
+		float sd = secondDist_(x, y);
+		if (b >= 0 && dsq > sd * sd * 1.000001f) return false;
+		float d = std::sqrt(dx * dx + dy * dy);
+		float& da = plateDist_(x, y);
+		float& db = secondDist_(x, y);
+		if (a < 0 || d < da || (d == da && id < a)) {
+			b = a;
+			db = da;
+			a = id;
+			da = d;
+			return true;
+		}
+		if (b < 0 || d < db || (d == db && id < b)) {
+			b = id;
+			db = d;
+			return true;
+		}
+		return false;
+	});
+}
+
+Rect WorldType_Voronoi::movePlate(int id, float x, float y) {
+	assert(id >= 0 && id < (int)plates_.size());
+	// rasters of the old layout first, requeryPlate finds the moved plate's old footprint through them
+	if (!hasPlateRasters()) initPlateRasters();
+	plates_[id].x = x;
+	plates_[id].y = y;
+	initPlateIndex();
+	return markDirty(requeryPlate(id, -1));
+}
+
+Rect WorldType_Voronoi::setPlateHeight(int id, float height) {
+	assert(id >= 0 && id < (int)plates_.size());
+	if (!hasPlateRasters()) initPlateRasters();
+	plates_[id].height = height;
+	// only the nearest plate's height/scale enters plateHeight()
+	return markDirty(scanRasters([&](int x, int y) { return plateId_(x, y) == id; }));
+}
+
+Rect WorldType_Voronoi::setPlateScale(int id, float scale) {
+	assert(id >= 0 && id < (int)plates_.size());
+	if (!hasPlateRasters()) initPlateRasters();
+	plates_[id].scale = scale;
+	return markDirty(scanRasters([&](int x, int y) { return plateId_(x, y) == id; }));
+}
+
+Rect WorldType_Voronoi::addPlate(float x, float y, float height, float scale) {
+	if (!hasPlateRasters()) initPlateRasters();
+	VoronoiPlate p;
+	p.id = (int)plates_.size();
+	p.seed = 0;
+	p.x = x;
+	p.y = y;
+	p.height = height;
+	p.scale = scale;
+	plates_.push_back(p);
+	initPlateIndex();
+	return markDirty(requeryPlate(p.id, -1));
+}
+
+Rect WorldType_Voronoi::removePlate(int id) {
+	assert(id >= 0 && id < (int)plates_.size());
+	if (!hasPlateRasters()) initPlateRasters();
+	plates_.erase(plates_.begin() + id);
+	for (int i = id; i < (int)plates_.size(); i++) plates_[i].id = i;
+	initPlateIndex();
+	return markDirty(requeryPlate(-1, id));
+}
+
+Rect WorldType_Voronoi::regenerateDirty(Grid2D<float>& outHeight, GridFloat* outGradX, GridFloat* outGradY) {
+	Rect r = takeDirtyRegion().intersect(Rect::ofGrid(width_, height_));
+	generate(outHeight, r, r.x, r.y, outGradX, outGradY);
+	return r;
+}
+
+NearestPlates WorldType_Voronoi::platesAt(int x, int y) const {
+	// off-map pixels (region generation) have no raster entry, they take the exact query
+	if (!hasPlateRasters() || x < 0 || y < 0 || x >= width_ || y >= height_) return nearestPlates((float)x + 0.5f, (float)y + 0.5f);
+	NearestPlates n;
+	int a = plateId_(x, y), b = secondId_(x, y);
+	n.best = a >= 0 ? &plates_[a] : nullptr;
+	n.second = b >= 0 ? &plates_[b] : nullptr;
+	n.bestDist = plateDist_(x, y);
+	n.secondDist = secondDist_(x, y);
+	return n;
+}
+
+float WorldType_Voronoi::voronoiHeightAt(float px, float py) const { return plateHeight(nearestPlates(px, py)); }
+
+float WorldType_Voronoi::plateHeight(const NearestPlates& n) const {
+	const VoronoiPlate* bestPlate = n.best;
 	float diag = std::sqrt((float)width_ * width_ + (float)height_ * height_);
-	float nd = bestDist / std::max(1.0f, diag);
-	float gap = (secondDist - bestDist) / std::max(1e-5f, diag);
+	float nd = n.bestDist / std::max(1.0f, diag);
+	float gap = (n.secondDist - n.bestDist) / std::max(1e-5f, diag);
 	float ridge = std::exp(-gap * cfg_.ridgeStrength * 16.0f);
 	float plateBase = bestPlate ? bestPlate->height : 0.0f;
 	float falloff = 1.0f - std::clamp(nd * (bestPlate ? bestPlate->scale : 1.0f), 0.0f, 1.0f);
@@ -60,17 +527,126 @@ float WorldType_Voronoi::voronoiHeightAt(int ix, int iy) const {
 	return std::clamp(h, -1.0f, 1.0f);
 }
 
-void WorldType_Voronoi::generate(Grid2D<float>& outHeight) {
+float WorldType_Voronoi::plateHeightD(const NearestPlates& n, float px, float py, float& dx, float& dy) const {
+	float h = plateHeight(n);
+	dx = dy = 0.0f;
+	if (!n.best || h <= -1.0f || h >= 1.0f) return h;
+
+	// d|p - c| / dp = (p - c) / |p - c|
+	float bx = n.bestDist > 0.0f ? (px - n.best->x) / n.bestDist : 0.0f;
+	float by = n.bestDist > 0.0f ? (py - n.best->y) / n.bestDist : 0.0f;
+	float sx = 0.0f, sy = 0.0f;
+	if (n.second && n.secondDist > 0.0f) {
+		sx = (px - n.second->x) / n.secondDist;
+		sy = (py - n.second->y) / n.secondDist;
+	}
+	float diag = std::sqrt((float)width_ * width_ + (float)height_ * height_);
+	float invNd = 1.0f / std::max(1.0f, diag);
+	float invGap = 1.0f / std::max(1e-5f, diag);
+	float gap = (n.secondDist - n.bestDist) * invGap;
+	float k = cfg_.ridgeStrength * 16.0f;
+	float ridge = std::exp(-gap * k);
+	float ridgeScale = 0.6f * n.best->height * ridge * -k * invGap;
+	dx += ridgeScale * (sx - bx);
+	dy += ridgeScale * (sy - by);
+
+	float t = n.bestDist * invNd * n.best->scale;
+	if (t > 0.0f && t < 1.0f) {
+		float fs = -0.2f * n.best->scale * invNd;
+		dx += fs * bx;
+		dy += fs * by;
+	}
+	return h;
+}
+
+void WorldType_Voronoi::generate(Grid2D<float>& outHeight, GridFloat* outGradX, GridFloat* outGradY) {
 	assert(outHeight.width() == width_ && outHeight.height() == height_);
-#pragma omp parallel for collapse(2)
-	for (int y = 0; y < height_; y++) {
-		for (int x = 0; x < width_; x++) {
-			float vor = voronoiHeightAt(x, y);			 // -1..1
-			float fbm = fbmNoiseAt((float)x, (float)y);	 // -1..1
-			float h = (1.0f - cfg_.fbmBlend) * vor + cfg_.fbmBlend * fbm;
-			h = std::tanh(h * 1.2f);
-			float mapped = (h + 1.0f) * 0.5f;
-			outHeight(x, y) = mapped;
+	const bool wantGrad = outGradX && outGradY;
+	if (wantGrad) {
+		if (outGradX->width() != width_ || outGradX->height() != height_) outGradX->resize(width_, height_);
+		if (outGradY->width() != width_ || outGradY->height() != height_) outGradY->resize(width_, height_);
+	}
+	generate(outHeight, Rect::ofGrid(width_, height_), 0, 0, outGradX, outGradY);
+}
+
+void WorldType_Voronoi::generate(Grid2D<float>& outHeight, const Rect& region, int outX, int outY, GridFloat* outGradX, GridFloat* outGradY) const {
+	if (region.empty()) return;
+	const bool wantGrad = outGradX && outGradY;
+	assert(Rect::ofGrid(outHeight.width(), outHeight.height()).contains(outX, outY));
+	assert(outX + region.w <= outHeight.width() && outY + region.h <= outHeight.height());
+	assert(!wantGrad || (outGradX->width() == outHeight.width() && outGradX->height() == outHeight.height()));
+	assert(!wantGrad || (outGradY->width() == outHeight.width() && outGradY->height() == outHeight.height()));
+#pragma omp parallel for schedule(static)
+	for (int j = 0; j < region.h; j++) {
+		size_t row = outHeight.index(outX, outY + j);
+		generateRow(region.y + j, region.x, region.w, outHeight.data() + row, wantGrad ? outGradX->data() + row : nullptr,
+					wantGrad ? outGradY->data() + row : nullptr);
+	}
+}
+
+void WorldType_Voronoi::generateRow(int y, int x0, int count, float* outHeight, float* outGradX, float* outGradY) const {
+	float py = (float)y + 0.5f;
+	// the fbm row is written straight into the outputs and combined in place
+	if (!outGradX || !outGradY) {
+		fbmNoiseRow(y, x0, count, outHeight);  // -1..1
+		for (int i = 0; i < count; i++) {
+			float vor = plateHeight(platesAt(x0 + i, y));	// -1..1
+			outHeight[i] = combineHeight(vor, outHeight[i]);
 		}
+		return;
+	}
+	withNoise([&](const auto& noise) {
+		if (warp_.enabled())
+			noise.fbmRowWarpedD((float)y, (float)x0, count, outHeight, outGradX, outGradY, cfg_.fbmFrequency, fbmTable_, warp_);
+		else
+			noise.fbmRowD((float)y, (float)x0, count, outHeight, outGradX, outGradY, cfg_.fbmFrequency, fbmTable_);
+	});
+	for (int i = 0; i < count; i++) {
+		float px = (float)(x0 + i) + 0.5f;
+		float vdx, vdy;
+		float vor = plateHeightD(platesAt(x0 + i, y), px, py, vdx, vdy);
+		float h = combineHeight(vor, outHeight[i]);
+		// d/dp of (tanh(1.2 * blend) + 1) / 2, with tanh' = 1 - tanh^2 = 1 - (2h - 1)^2
+		float th = h * 2.0f - 1.0f;
+		float s = 0.6f * (1.0f - th * th);
+		outHeight[i] = h;
+		outGradX[i] = s * ((1.0f - cfg_.fbmBlend) * vdx + cfg_.fbmBlend * outGradX[i]);
+		outGradY[i] = s * ((1.0f - cfg_.fbmBlend) * vdy + cfg_.fbmBlend * outGradY[i]);
 	}
 }
+
+void WorldType_Voronoi::generateLod(Grid2D<float>& outHeight, float sampleSpacing) {
+	assert(sampleSpacing >= 1.0f);
+	const int outW = (int)std::ceil((float)width_ / sampleSpacing);
+	const int outH = (int)std::ceil((float)height_ / sampleSpacing);
+	if (outHeight.width() != outW || outHeight.height() != outH) outHeight.resize(outW, outH);
+
+	FbmTable full(cfg_.fbmOctaves, cfg_.fbmLacunarity, cfg_.fbmGain);
+	const FbmTable table = cfg_.fbmBandLimit ? full.bandLimited(cfg_.fbmFrequency, sampleSpacing) : full;
+	const DomainWarp warp = warpFor(sampleSpacing);
+#pragma omp parallel
+	{
+		std::vector<float> fbmRow(outW);
+#pragma omp for schedule(static)
+		for (int y = 0; y < outH; y++) {
+			float wy = (float)y * sampleSpacing;
+			withNoise([&](const auto& noise) {
+				if (warp.enabled())
+					noise.fbmRowWarped(wy, 0.0f, outW, fbmRow.data(), cfg_.fbmFrequency, table, warp, sampleSpacing);
+				else
+					noise.fbmRow(wy, 0.0f, outW, fbmRow.data(), cfg_.fbmFrequency, table, sampleSpacing);
+			});
+			for (int x = 0; x < outW; x++) {
+				// voronoi at the centre of the footprint, fbm at its corner like the full-res pass
+				float vor = voronoiHeightAt(((float)x + 0.5f) * sampleSpacing, wy + 0.5f * sampleSpacing);
+				outHeight(x, y) = combineHeight(vor, fbmRow[x]);
+			}
+		}
+	}
+}
+
+float WorldType_Voronoi::combineHeight(float vor, float fbm) const {
+	float h = (1.0f - cfg_.fbmBlend) * vor + cfg_.fbmBlend * fbm;
+	h = std::tanh(h * 1.2f);
+	return (h + 1.0f) * 0.5f;
+}
\ No newline at end of file
@@ -12,6 +12,14 @@ struct VoronoiPlate {
 	float scale;
 };
 
+// nearest and second-nearest plate of a sample, distances are euclidean
+struct NearestPlates {
+	const VoronoiPlate* best = nullptr;
+	const VoronoiPlate* second = nullptr;
+	float bestDist = 1e9f;
+	float secondDist = 1e9f;
+};
+
 struct VoronoiConfig {
 	int seed = 1337;
 	int numPlates = 24;
@@ -21,19 +29,129 @@ struct VoronoiConfig {
 	float fbmFrequency = 0.004f;
 	float fbmLacunarity = 2.0f;
 	float fbmGain = 0.5f;
+	bool fbmBandLimit = true;  // drop/fade octaves the sample spacing cannot resolve
+	NoiseBackend noiseBackend = NoiseBackend::Permutation;  // Hash = table-free, non-repeating lattice
+	// domain warp of the fbm layer, in world units (0 = off)
+	float warpStrength = 0.0f;
+	float warpFrequency = 0.002f;
+	int warpOctaves = 3;
+	// build plate id / distance rasters with jump flooding and take the plate terms from them
+	// (approximate, O(N log N)) instead of an exact nearest-plate query per pixel. off, the rasters a
+	// plate edit needs are filled from the exact query instead
+	bool plateRaster = false;
 };
 
 class WorldType_Voronoi {
    public:
 	WorldType_Voronoi(int width, int height, const VoronoiConfig& cfg);
-	void generate(Grid2D<float>& outHeight);
+	// outGradX/outGradY (optional, both or neither) receive the analytic dh/dx, dh/dy of the output
+	// height per pixel, produced alongside the height instead of by finite differences afterwards
+	void generate(Grid2D<float>& outHeight, GridFloat* outGradX = nullptr, GridFloat* outGradY = nullptr);
+	// any rectangle of the world (world pixel coords, may reach outside the map) written to the
+	// outputs starting at (outX, outY). values are identical to the same pixels of the full-map generate()
+	void generate(Grid2D<float>& outHeight, const Rect& region, int outX = 0, int outY = 0, GridFloat* outGradX = nullptr,
+				  GridFloat* outGradY = nullptr) const;
+	// height (and optionally gradient) for pixels x0 .. x0 + count - 1 of row y, same values as generate().
+	// this is the unit a fused noise graph node calls (see NoiseGraph.h)
+	void generateRow(int y, int x0, int count, float* outHeight, float* outGradX = nullptr, float* outGradY = nullptr) const;
+	// preview / LOD pass over the same world, each output pixel covers sampleSpacing world units.
+	// outHeight is resized to ceil(width / spacing) x ceil(height / spacing)
+	void generateLod(Grid2D<float>& outHeight, float sampleSpacing);
+
+	// plate edits. each returns the map pixels whose height changes (cells whose nearest / second plate
+	// changed, or whose nearest plate was edited); the rasters are updated in place and built first if
+	// needed. edits accumulate into dirtyRegion() until regenerateDirty() / takeDirtyRegion()
+	Rect movePlate(int id, float x, float y);
+	Rect setPlateHeight(int id, float height);
+	Rect setPlateScale(int id, float scale);
+	// new plate gets id numPlates() - 1
+	Rect addPlate(float x, float y, float height, float scale);
+	// ids above `id` shift down by one
+	Rect removePlate(int id);
+	int numPlates() const { return (int)plates_.size(); }
+	const VoronoiPlate& plate(int id) const { return plates_[id]; }
+
+	const Rect& dirtyRegion() const { return dirty_; }
+	Rect takeDirtyRegion() {
+		Rect r = dirty_;
+		dirty_ = Rect();
+		return r;
+	}
+	// regenerate only the dirty region of a full-map height (+ gradient) and hand that region back, so
+	// later stages can limit their work to it (inflate it by their own kernel radius)
+	Rect regenerateDirty(Grid2D<float>& outHeight, GridFloat* outGradX = nullptr, GridFloat* outGradY = nullptr);
+
+	// per-pixel plate rasters (pixel centres), only filled when cfg.plateRaster is set or after an edit
+	bool hasPlateRasters() const { return plateId_.size() > 0; }
+	const GridInt& plateIdRaster() const { return plateId_; }
+	const GridInt& secondPlateIdRaster() const { return secondId_; }
+	const GridFloat& plateDistRaster() const { return plateDist_; }
+	const GridFloat& secondPlateDistRaster() const { return secondDist_; }
+	// distance to the plate boundary, (second - nearest) / 2
+	float boundaryDistance(int x, int y) const { return 0.5f * (secondDist_(x, y) - plateDist_(x, y)); }
 
    private:
 	int width_, height_;
 	VoronoiConfig cfg_;
 	std::vector<VoronoiPlate> plates_;
 	PerlinNoise noise_;
+	HashedPerlinNoise hashNoise_;
+	FbmTable fbmTable_;
+	DomainWarp warp_;
+	// fbm specializations matching cfg_.fbmOctaves, picked once in the constructor (null = generic loop)
+	float (WorldType_Voronoi::*fbmAt_)(float, float) const = nullptr;
+	void (WorldType_Voronoi::*fbmRow_)(int, int, int, float*) const = nullptr;
+	// uniform bucket grid over the plate bounding box for nearestPlates(), ~2 plates per cell.
+	// cellStart_ is CSR style: plates of cell c are cellPlates_[cellStart_[c] .. cellStart_[c + 1])
+	int gridW_ = 0, gridH_ = 0;
+	float gridX0_ = 0.0f, gridY0_ = 0.0f, cellSize_ = 1.0f;
+	std::vector<int> cellStart_, cellPlates_;
+	GridInt plateId_, secondId_;
+	GridFloat plateDist_, secondDist_;
+	Rect dirty_;
+	template <class Fn>
+	Rect scanRasters(Fn&& fn);
+	Rect requeryPlate(int id, int removed);
+	Rect markDirty(const Rect& r);
 	void initPlates();
-	float voronoiHeightAt(int ix, int iy) const;
+	void initPlateIndex();
+	void initPlateRasters();
+	NearestPlates platesAt(int x, int y) const;
+	NearestPlates nearestPlatesBrute(float px, float py) const;
+	void initFbm();
+	DomainWarp warpFor(float sampleSpacing) const;
+	NearestPlates nearestPlates(float px, float py) const;
+	float voronoiHeightAt(float px, float py) const;
+	float plateHeight(const NearestPlates& n) const;
+	float plateHeightD(const NearestPlates& n, float px, float py, float& dx, float& dy) const;
+	float combineHeight(float vor, float fbm) const;
 	float fbmNoiseAt(float fx, float fy) const;
+	void fbmNoiseRow(int iy, int x0, int count, float* out) const;
+
+	// calls fn with whichever noise object cfg_.noiseBackend selects
+	template <class Fn>
+	decltype(auto) withNoise(Fn&& fn) const {
+		if (cfg_.noiseBackend == NoiseBackend::Hash) return fn(hashNoise_);
+		return fn(noise_);
+	}
+	template <class Noise>
+	const Noise& noiseOf() const {
+		if constexpr (std::is_same_v<Noise, HashedPerlinNoise>)
+			return hashNoise_;
+		else
+			return noise_;
+	}
+
+	template <class Noise, int Octaves>
+	float fbmBakedAt(float fx, float fy) const {
+		return noiseOf<Noise>().template fbm<Octaves>(fx, fy, cfg_.fbmFrequency);
+	}
+	template <class Noise, int Octaves>
+	float fbmTableAt(float fx, float fy) const {
+		return noiseOf<Noise>().template fbm<Octaves>(fx, fy, cfg_.fbmFrequency, fbmTable_);
+	}
+	template <class Noise, int Octaves>
+	void fbmTableRow(int iy, int x0, int count, float* out) const {
+		noiseOf<Noise>().template fbmRow<Octaves>((float)iy, (float)x0, count, out, cfg_.fbmFrequency, fbmTable_);
+	}
 };
@@ -0,0 +1,46 @@
+// a time-budgeted erosion run must spend its budget on droplets: its droplets per ms should match an
+// unbudgeted run's, on a map large enough that per-chunk buffer setup would show
+
+#include <algorithm>
+#include <cstdio>
+
+#include "HydraulicErosion.h"
+#include "WorldType_Voronoi.h"
+
+static double dropletsPerMs(const GridFloat &height, const ErosionParams &params, int &applied) {
+	double best = 0.0;
+	for (int run = 0; run < 3; run++) {
+		GridFloat h = height;
+		erosion::ErosionStats stats = erosion::runHydraulicErosion(h, params);
+		applied = stats.appliedDroplets;
+		best = std::max(best, stats.appliedDroplets / std::max(stats.elapsedMs, 1e-3));
+	}
+	return best;
+}
+
+int main() {
+	const int W = 1024, H = 1024;
+	VoronoiConfig vc;
+	WorldType_Voronoi world(W, H, vc);
+	GridFloat height(W, H);
+	world.generate(height);
+
+	int failures = 0;
+	for (bool perThread : {true, false}) {
+		ErosionParams params;
+		params.numDroplets = 65536;
+		params.maxSteps = 45;
+		params.usePerThreadBuffers = perThread;
+
+		int full = 0, budgeted = 0;
+		double rateFull = dropletsPerMs(height, params, full);
+		params.timeBudgetMs = 0.4 * full / rateFull;
+		double rateBudget = dropletsPerMs(height, params, budgeted);
+
+		bool ok = full == params.numDroplets && budgeted > 0 && budgeted < full && rateBudget >= 0.75 * rateFull;
+		std::printf("%s engine: unbudgeted %d droplets, %.1f/ms; budget %.1f ms: %d droplets, %.1f/ms  %s\n", perThread ? "perThread" : "tiled", full,
+					rateFull, params.timeBudgetMs, budgeted, rateBudget, ok ? "ok" : "FAILED");
+		failures += !ok;
+	}
+	return failures ? 1 : 0;
+}